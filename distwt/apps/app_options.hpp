@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// command-line options passed from the launcher to the MPI apps
+struct AppOptions {
+    std::string input_filename;
+    std::string output;
+    std::string hist_filename; // previously saved histogram of the input
+
+    size_t prefix = SIZE_MAX; // default to whole file
+    size_t rdbufsize = 0;     // default to local input size
+
+    bool eff_input = false;   // input is already in the effective alphabet
+    bool single_file = false; // write one file per level instead of per worker
+    bool mmap_input = false;  // map the local input instead of reading it
+    bool matrix = false;      // construct a wavelet matrix instead of a tree
+    bool huffman = false;     // construct a Huffman-shaped tree
+    bool packed = false;      // bit-slice the effective text of small trees
+    bool sparse_nodes = false; // store only the non-empty local nodes
+
+    size_t subtree_levels = 0; // top levels of mpi_hybrid, 0 for automatic
+};
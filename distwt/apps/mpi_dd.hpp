@@ -1,7 +1,13 @@
+#pragma once
+
 #include <string>
 #include <vector>
 #include <limits>
+#include <optional>
+
+#include <distwt/apps/app_options.hpp>
 
+#include <distwt/common/huffman.hpp>
 #include <distwt/common/util.hpp>
 #include <distwt/common/wt_sequential.hpp>
 
@@ -16,6 +22,7 @@
 #include <distwt/mpi/result.hpp>
 
 #include <src/alignment_allocator.hpp>
+#include <src/wt_sparse_nodebased.hpp>
 
 template<typename shared_t>
 class mpi_dd {
@@ -24,11 +31,7 @@ public:
 template<typename sym_t>
 static void start(
     MPIContext& ctx,
-    const std::string& input_filename,
-    const size_t prefix,
-    const size_t in_rdbufsize,
-    const bool eff_input,
-    const std::string& output) {
+    const AppOptions& options) {
 
     Result::Time time;
     double t0 = ctx.time();
@@ -41,46 +44,164 @@ static void start(
     };
 
     // Determine input partition
-    FilePartitionReader<sym_t> input(ctx, input_filename, prefix);
+    FilePartitionReader<sym_t> input(ctx, options.input_filename, options.prefix);
     const size_t local_num = input.local_num();
-    const size_t rdbufsize = (in_rdbufsize > 0) ? in_rdbufsize : std::min(local_num, static_cast<size_t>(std::numeric_limits<int>::max()));
-    input.buffer(rdbufsize);
+    const size_t rdbufsize = (options.rdbufsize > 0) ? options.rdbufsize : std::min(local_num, static_cast<size_t>(std::numeric_limits<int>::max()));
+    // serve the input from the page cache if requested, else read it into RAM
+    if(!options.mmap_input || !input.map()) {
+        input.buffer(rdbufsize);
+    }
     
     time.input = dt();
 
-    // Compute histogram
-    ctx.cout_master() << "Compute histogram ..." << std::endl;
-    Histogram<sym_t> hist(ctx, input, rdbufsize);
+    // Compute histogram, for an input in the effective alphabet only its
+    // size is determined, the counts follow from the local trees' leaves
+    Histogram<sym_t> hist;
+    if(!options.hist_filename.empty()) {
+        ctx.cout_master() << "Load histogram ..." << std::endl;
+        hist = Histogram<sym_t>(ctx, input, rdbufsize, options.hist_filename);
+    }
+
+    const bool count_leaves = options.eff_input &&
+        (options.hist_filename.empty() || !hist.is_effective());
+    if(count_leaves) {
+        ctx.cout_master() << "Determine alphabet size ..." << std::endl;
+        hist = Histogram<sym_t>(Histogram<sym_t>::effective_sigma(ctx, input, rdbufsize));
+    } else if(options.hist_filename.empty()) {
+        ctx.cout_master() << "Compute histogram ..." << std::endl;
+        hist = Histogram<sym_t>(ctx, input, rdbufsize);
+    }
 
     time.hist = dt();
 
-    // Compute effective alphabet
-    EffectiveAlphabet<sym_t> ea(hist);
-
-    // Transform text and cache in RAM
-    ctx.cout_master() << "Compute effective transformation ..." << std::endl;
-    std::vector<sym_t, Alignment_allocator<sym_t>> etext(local_num);
-#pragma omp parallel
-    {
-        input.process_local_omp([&](const size_t idx, const sym_t x) {
-            etext[idx] = ea.map(x);
-        }, rdbufsize);
+    // Compute effective alphabet unless the input already is in it
+    std::optional<EffectiveAlphabet<sym_t>> ea;
+    if(!options.eff_input) {
+        ea.emplace(hist);
+    }
+
+    // Compute Huffman code if requested
+    HuffmanCode code;
+    if(options.huffman) {
+        code = HuffmanCode(hist);
     }
 
+    const sym_t* in = input.local_data();
+
+    // trees with more nodes than local input symbols only keep their
+    // non-empty local nodes, which is decided from global values alike on
+    // all workers, because the merge communicates differently
+    const WaveletTreeBase shape(hist);
+    const bool sparse = options.sparse_nodes || (!options.matrix && !options.huffman &&
+        shape.num_nodes() > input.size_per_worker());
+
     time.eff = dt();
-    input.free();
 
     // recursive WT
     ctx.cout_master() << "Compute local WTs ..." << std::endl;
-    auto wt_nodes = WaveletTreeNodebased(hist,
-    [&](WaveletTree::bits_t& bits, const WaveletTreeBase& wt){
+    auto construct = [&](WaveletTree::bits_t& bits, const WaveletTreeBase& wt){
+        bits.resize(wt.num_nodes());
+        if(options.eff_input) {
+            // construct straight from the input
+            shared_t::template start<sym_t, idx_t>(wt, bits, in, local_num);
+            return;
+        }
+
+        // The effective transformation is fused into the root level pass of
+        // the local construction, which stores the text and counts the leaf
+        // histogram while writing the root bits
+        auto start = [&](auto map) {
+            // small trees may use a bit-sliced text of h bits per symbol
+            if constexpr(shared_t::PACKED_MAX_HEIGHT > 0) {
+                if(options.packed && wt.height() <= shared_t::PACKED_MAX_HEIGHT) {
+                    shared_t::template start_packed<idx_t>(wt, bits, local_num, map);
+                    return;
+                }
+            }
+
+            // otherwise, the text is stored in the narrowest type that holds
+            // the tree's symbols, which every further level pass streams
+            util::with_narrowest_uint<sym_t>(wt.height(), [&](auto esym) {
+                using esym_t = decltype(esym);
+                std::vector<esym_t, Alignment_allocator<esym_t>> etext(local_num);
+
+                shared_t::template start<esym_t, idx_t>(wt, bits, etext,
+                    [&](const size_t i){ return esym_t(map(i)); });
+            });
+        };
+
+        start([&](const size_t i){ return uint64_t(ea->map(in[i])); });
+    };
+
+    // Huffman-shaped WT
+    // the padded codes follow the Huffman tree's paths in a balanced tree
+    // of the same height, they are sorted by prefix level by level and every
+    // symbol is dropped at its leaf, so it is processed once per code bit
+    auto construct_huffman = [&](WaveletTree::bits_t& bits, const WaveletTreeBase& wt){
+        const size_t h = wt.height();
         bits.resize(wt.num_nodes());
-        shared_t::template start<sym_t, idx_t>(wt, bits, etext);
-    });
+
+        // a node is inner iff a symbol's code passes it
+        const auto node_sizes = code.node_sizes(hist);
+
+        NodeDirectory nodes;
+        util::with_narrowest_uint<sym_t>(h, [&](auto esym) {
+            using esym_t = decltype(esym);
+            std::vector<esym_t, Alignment_allocator<esym_t>> etext(local_num);
+#pragma omp parallel for
+            for(size_t i = 0; i < local_num; i++) etext[i] = esym_t(code.padded(ea->map(in[i])));
+
+            wt_sparse_nodebased::start(nodes, etext, h,
+                [&](const size_t node_id){ return node_sizes[node_id - 1] != idx_t(0); });
+        });
+
+        // move the nodes' runs into their own bit vectors
+        for(size_t level = 0; level < h; level++) {
+            const auto& level_nodes = nodes.nodes(level);
+            for(const auto& node : level_nodes) {
+                bits[node.node_id - 1].resize(node.size);
+            }
+
+            const uint64_t* words = nodes.bits(level).data();
+#pragma omp parallel for schedule(nonmonotonic : dynamic, 16)
+            for(size_t i = 0; i < level_nodes.size(); i++) {
+                const auto& node = level_nodes[i];
+                copy_bits(bits[node.node_id - 1].data(), 0, words, node.offs, node.size);
+            }
+            nodes.clear(level);
+        }
+    };
+
+    auto construct_sparse = [&](){
+        NodeDirectory nodes;
+        util::with_narrowest_uint<sym_t>(shape.height(), [&](auto esym) {
+            using esym_t = decltype(esym);
+            std::vector<esym_t, Alignment_allocator<esym_t>> etext(local_num);
+            if(options.eff_input) {
+#pragma omp parallel for
+                for(size_t i = 0; i < local_num; i++) etext[i] = esym_t(in[i]);
+            } else {
+#pragma omp parallel for
+                for(size_t i = 0; i < local_num; i++) etext[i] = esym_t(ea->map(in[i]));
+            }
+
+            wt_sparse_nodebased::start(nodes, etext, shape.height());
+        });
+        return nodes;
+    };
+
+    auto wt_nodes = sparse
+        ? WaveletTreeNodebased(hist, construct_sparse())
+        : options.huffman
+            ? WaveletTreeNodebased(hist, code.height(), construct_huffman)
+            : WaveletTreeNodebased(hist, construct);
+
+    if(count_leaves) {
+        hist.reduce_counts(ctx, wt_nodes.leaf_counts());
+    }
 
     // Clean up
-    etext.clear();
-    etext.shrink_to_fit();
+    input.free();
 
     // Synchronize
     ctx.cout_master() << "Done computing " << wt_nodes.num_nodes()
@@ -89,20 +210,49 @@ static void start(
 
     time.construct = dt();
 
-    // Convert to level-wise representation
-    WaveletTreeLevelwise wt = wt_nodes.merge(ctx, input, hist, true);
-    time.merge = dt();
+    // write levels to disk if needed
+    const std::string& output = options.output;
+    auto save = [&](WaveletTreeLevelwise& wt){
+        if(output.length() > 0) {
+            ctx.synchronize();
+            ctx.cout_master() << "Writing WT to disk ..." << std::endl;
 
-    // write to disk if needed
-    if(output.length() > 0) {
-        ctx.synchronize();
-        ctx.cout_master() << "Writing WT to disk ..." << std::endl;
+            if(ctx.rank() == 0) {
+                hist.save(output + "." + WaveletTreeBase::histogram_extension());
+                if(options.huffman) {
+                    code.save(output + "." + HuffmanCode::code_extension());
+                }
+            }
 
-        if(ctx.rank() == 0) {
-            hist.save(output + "." + WaveletTreeBase::histogram_extension());
+            if(options.single_file) {
+                wt.save_single_file(ctx, output);
+            } else {
+                wt.save(ctx, output);
+            }
         }
+    };
+
+    if(options.matrix) {
+        // Convert to wavelet matrix
+        WaveletMatrix wm = wt_nodes.merge_matrix(ctx, input, hist, true);
+        time.merge = dt();
+
+        save(wm);
+        if(output.length() > 0 && ctx.rank() == 0) {
+            wm.save_zeros(output);
+        }
+    } else if(options.huffman) {
+        // Convert to the variable-length levels of the Huffman-shaped tree
+        WaveletTreeLevelwise wt = wt_nodes.merge_huffman(ctx, input, hist, code, true);
+        time.merge = dt();
+
+        save(wt);
+    } else {
+        // Convert to level-wise representation
+        WaveletTreeLevelwise wt = wt_nodes.merge(ctx, input, hist, true);
+        time.merge = dt();
 
-        wt.save(ctx, output);
+        save(wt);
     }
 
     // Synchronize for exit
@@ -110,7 +260,10 @@ static void start(
     ctx.synchronize();
 
     // gather stats
-    Result result("mpi-dd-" + shared_t::name(), ctx, input, wt.sigma(), time);
+    Result result(
+        std::string("mpi-dd-") + (options.matrix ? "wm-" : "") +
+            (options.huffman ? "huff" : sparse ? "sparse" : shared_t::name()),
+        ctx, input, hist.size(), time);
 
     ctx.cout_master() << result.readable() << std::endl
                       << result.sqlplot() << std::endl;
@@ -0,0 +1,400 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <limits>
+
+#include <omp.h>
+#include <tlx/math/integer_log2.hpp>
+
+#include <distwt/apps/app_options.hpp>
+
+#include <distwt/common/util.hpp>
+#include <distwt/common/wt_sequential.hpp>
+
+#include <distwt/mpi/file_partition_reader.hpp>
+
+#include <distwt/mpi/histogram.hpp>
+#include <distwt/mpi/effective_alphabet.hpp>
+#include <distwt/mpi/bit_vector.hpp>
+#include <distwt/mpi/wt_nodebased.hpp>
+#include <distwt/mpi/wt_levelwise.hpp>
+
+#include <distwt/mpi/result.hpp>
+
+#include <src/alignment_allocator.hpp>
+
+// subtree decomposition - the top levels are constructed domain decomposed
+// and merged like in mpi_dd, then the text is redistributed so that every
+// worker owns a contiguous range of whole subtrees, which it constructs
+// without any further communication
+template<typename shared_t>
+class mpi_hybrid {
+public:
+
+template<typename sym_t>
+static void start(
+    MPIContext& ctx,
+    const AppOptions& options) {
+
+    Result::Time time;
+    double t0 = ctx.time();
+
+    auto dt = [&](){
+        const double t = ctx.time();
+        const double dt = t - t0;
+        t0 = t;
+        return dt;
+    };
+
+    const size_t rank = ctx.rank();
+    const size_t num_workers = ctx.num_workers();
+
+    // Determine input partition
+    FilePartitionReader<sym_t> input(ctx, options.input_filename, options.prefix);
+    const size_t local_num = input.local_num();
+    const size_t rdbufsize = (options.rdbufsize > 0) ? options.rdbufsize : std::min(local_num, static_cast<size_t>(std::numeric_limits<int>::max()));
+    if(!options.mmap_input || !input.map()) {
+        input.buffer(rdbufsize);
+    }
+
+    time.input = dt();
+
+    // Compute histogram
+    ctx.cout_master() << "Compute histogram ..." << std::endl;
+    Histogram<sym_t> hist(ctx, input, rdbufsize, options.hist_filename);
+
+    time.hist = dt();
+
+    // Compute effective alphabet
+    EffectiveAlphabet<sym_t> ea(hist);
+
+    // Determine the amount of top levels, by default four subtrees per worker,
+    // a text of a single symbol has a tree without any levels
+    const size_t height = WaveletTreeBase(hist).height();
+    const size_t top_levels = std::min(height, std::max(size_t(1),
+        options.subtree_levels > 0
+            ? options.subtree_levels
+            : size_t(tlx::integer_log2_ceil(num_workers)) + 2));
+
+    const size_t sub_height = height - top_levels;
+    const size_t num_subtrees = 1ULL << top_levels;
+
+    // Assign contiguous ranges of subtrees to the workers,
+    // balanced by the global subtree sizes
+    std::vector<size_t> subtree_sizes(num_subtrees, 0);
+    {
+        size_t i = 0;
+        for(const auto& e : hist.entries) {
+            subtree_sizes[i++ >> sub_height] += size_t(e.second);
+        }
+    }
+
+    std::vector<size_t> owner(num_subtrees);
+    std::vector<size_t> first_subtree(num_workers + 1, num_subtrees);
+    {
+        const size_t n = input.total_size();
+        size_t offs = 0;
+        for(size_t j = 0; j < num_subtrees; j++) {
+            // the worker whose balanced share contains the subtree's center
+            const size_t center = offs + subtree_sizes[j] / 2;
+            owner[j] = (n > 0) ? std::min(num_workers - 1, center * num_workers / n) : 0;
+            offs += subtree_sizes[j];
+        }
+
+        for(size_t j = num_subtrees; j-- > 0;) {
+            first_subtree[owner[j]] = j;
+        }
+        for(size_t r = num_workers; r-- > 0;) {
+            first_subtree[r] = std::min(first_subtree[r], first_subtree[r+1]);
+        }
+    }
+
+    const size_t subtree_begin = first_subtree[rank];
+    const size_t subtree_end = first_subtree[rank+1];
+
+    // the top levels only see the symbols' prefixes, which are stored in
+    // the local text, while the pass also keeps the full effective symbols
+    // if there are subtrees, which determine the symbols' targets and are
+    // redistributed afterwards
+    std::vector<sym_t, Alignment_allocator<sym_t>> etext(local_num);
+    std::vector<sym_t> eff(sub_height > 0 ? local_num : 0);
+    const sym_t* in = input.local_data();
+
+    time.eff = dt();
+
+    // recursive WT of the top levels
+    ctx.cout_master() << "Compute local WTs of the top " << top_levels
+        << " levels ..." << std::endl;
+    auto wt_nodes = WaveletTreeNodebased(hist, top_levels,
+    [&](WaveletTree::bits_t& bits, const WaveletTreeBase& wt){
+        bits.resize(wt.num_nodes());
+        if(sub_height > 0) {
+            shared_t::template start<sym_t, idx_t>(wt, bits, etext,
+                [&](const size_t i){
+                    const sym_t c = ea.map(in[i]);
+                    eff[i] = c;
+                    return sym_t(c >> sub_height);
+                });
+        } else if(top_levels > 0) {
+            shared_t::template start<sym_t, idx_t>(wt, bits, etext,
+                [&](const size_t i){ return ea.map(in[i]); });
+        }
+    });
+
+    // Clean up
+    input.free();
+    etext.clear();
+    etext.shrink_to_fit();
+
+    // Redistribute the text by subtrees,
+    // the nodes of every local subtree are numbered from its root
+    std::vector<WaveletTree::bits_t> sub_bits;
+    if(sub_height > 0) {
+        ctx.cout_master() << "Redistribute text to " << num_subtrees
+            << " subtrees ..." << std::endl;
+
+        std::vector<sym_t> recv_buf;
+        {
+            // stable partition of the effective text by target
+            const size_t num_threads = omp_get_max_threads();
+            std::vector<size_t> thread_counts(num_threads * num_workers, 0);
+
+#pragma omp parallel
+            {
+                const size_t t = omp_get_thread_num();
+                const size_t begin = t * local_num / num_threads;
+                const size_t end = (t+1) * local_num / num_threads;
+
+                size_t* counts = thread_counts.data() + t * num_workers;
+                for(size_t i = begin; i < end; i++) {
+                    ++counts[owner[size_t(eff[i]) >> sub_height]];
+                }
+            }
+
+            std::vector<int> send_counts(num_workers, 0);
+            std::vector<int> send_displs(num_workers, 0);
+            {
+                size_t offs = 0;
+                for(size_t r = 0; r < num_workers; r++) {
+                    const size_t displ = offs;
+                    for(size_t t = 0; t < num_threads; t++) {
+                        const size_t count = thread_counts[t * num_workers + r];
+                        thread_counts[t * num_workers + r] = offs;
+                        offs += count;
+                    }
+                    send_displs[r] = mpi_count(displ);
+                    send_counts[r] = mpi_count(offs - displ);
+                }
+            }
+
+            std::vector<sym_t> send_buf(local_num);
+#pragma omp parallel
+            {
+                const size_t t = omp_get_thread_num();
+                const size_t begin = t * local_num / num_threads;
+                const size_t end = (t+1) * local_num / num_threads;
+
+                size_t* offs = thread_counts.data() + t * num_workers;
+                for(size_t i = begin; i < end; i++) {
+                    const sym_t c = eff[i];
+                    send_buf[offs[owner[size_t(c) >> sub_height]]++] = c;
+                }
+            }
+
+            // Clean up
+            eff.clear();
+            eff.shrink_to_fit();
+
+            std::vector<int> recv_counts(num_workers);
+            ctx.alltoall(send_counts.data(), recv_counts.data(), 1);
+
+            std::vector<int> recv_displs(num_workers, 0);
+            for(size_t r = 1; r < num_workers; r++) {
+                recv_displs[r] = mpi_count(size_t(recv_displs[r-1]) + size_t(recv_counts[r-1]));
+            }
+
+            recv_buf.resize(size_t(recv_displs.back()) + size_t(recv_counts.back()));
+            ctx.alltoallv(
+                send_buf.data(), send_counts, send_displs,
+                recv_buf.data(), recv_counts, recv_displs);
+        }
+
+        // split the received symbols into the texts of the local subtrees,
+        // which keeps the global text order because the workers' blocks
+        // are received in rank order, a subtree only sees the symbols' suffixes
+        const size_t num_local_subtrees = subtree_end - subtree_begin;
+        const size_t sub_mask = (1ULL << sub_height) - 1;
+        std::vector<std::vector<sym_t>> sub_texts(num_local_subtrees);
+        for(size_t j = 0; j < num_local_subtrees; j++) {
+            sub_texts[j].resize(subtree_sizes[subtree_begin + j]);
+        }
+        {
+            // every thread scatters a contiguous slice of the received symbols
+            // at its offsets within the subtrees' texts
+            const size_t recv_num = recv_buf.size();
+            const size_t num_threads = omp_get_max_threads();
+            std::vector<size_t> thread_counts(num_threads * num_local_subtrees, 0);
+
+#pragma omp parallel
+            {
+                const size_t t = omp_get_thread_num();
+                const size_t begin = t * recv_num / num_threads;
+                const size_t end = (t+1) * recv_num / num_threads;
+
+                size_t* counts = thread_counts.data() + t * num_local_subtrees;
+                for(size_t i = begin; i < end; i++) {
+                    ++counts[(size_t(recv_buf[i]) >> sub_height) - subtree_begin];
+                }
+            }
+
+            for(size_t j = 0; j < num_local_subtrees; j++) {
+                size_t offs = 0;
+                for(size_t t = 0; t < num_threads; t++) {
+                    const size_t count = thread_counts[t * num_local_subtrees + j];
+                    thread_counts[t * num_local_subtrees + j] = offs;
+                    offs += count;
+                }
+                assert(offs == sub_texts[j].size());
+            }
+
+#pragma omp parallel
+            {
+                const size_t t = omp_get_thread_num();
+                const size_t begin = t * recv_num / num_threads;
+                const size_t end = (t+1) * recv_num / num_threads;
+
+                size_t* offs = thread_counts.data() + t * num_local_subtrees;
+                for(size_t i = begin; i < end; i++) {
+                    const size_t c = size_t(recv_buf[i]);
+                    const size_t j = (c >> sub_height) - subtree_begin;
+                    sub_texts[j][offs[j]++] = sym_t(c & sub_mask);
+                }
+            }
+        }
+        recv_buf.clear();
+        recv_buf.shrink_to_fit();
+
+        // Construct the local subtrees
+        ctx.cout_master() << "Compute " << num_local_subtrees
+            << " local subtrees ..." << std::endl;
+
+        // the nodes are allocated up front, because a subtree is owned by a
+        // single worker, its node sizes follow from the histogram
+        const size_t sub_sigma = 1ULL << sub_height;
+        sub_bits.resize(num_local_subtrees);
+        {
+            std::vector<size_t> sizes(sub_sigma);
+            for(size_t j = 0; j < num_local_subtrees; j++) {
+                const size_t first_sym = (subtree_begin + j) << sub_height;
+                for(size_t v = 0; v < sub_sigma; v++) {
+                    sizes[v] = (first_sym + v < hist.size())
+                        ? size_t(hist.entries[first_sym + v].second) : 0;
+                }
+
+                auto& nodes = sub_bits[j];
+                nodes.resize(sub_sigma - 1);
+                for(size_t level = sub_height; level-- > 0;) {
+                    const size_t num_level_nodes = 1ULL << level;
+                    for(size_t v = 0; v < num_level_nodes; v++) {
+                        sizes[v] = sizes[2 * v] + sizes[2 * v + 1];
+                        nodes[num_level_nodes + v - 1].resize(sizes[v]);
+                    }
+                }
+            }
+        }
+
+        // the counters of every thread
+        const size_t num_threads = omp_get_max_threads();
+        std::vector<idx_t> thread_hist(num_threads * sub_sigma);
+        std::vector<idx_t> thread_count(num_threads * sub_sigma / 2);
+
+#pragma omp parallel for schedule(nonmonotonic : dynamic, 1)
+        for(size_t j = 0; j < num_local_subtrees; j++) {
+            const size_t t = omp_get_thread_num();
+            wt_pc<sym_t, idx_t>(sub_bits[j], sub_texts[j], 1, sub_height,
+                thread_hist.data() + t * sub_sigma,
+                thread_count.data() + t * sub_sigma / 2);
+        }
+
+        sub_texts.clear();
+        sub_texts.shrink_to_fit();
+    }
+
+    // Synchronize
+    ctx.cout_master() << "Done computing nodes. Synchronizing ..." << std::endl;
+    ctx.synchronize();
+
+    time.construct = dt();
+
+    // Merge the top levels and append the levels of the local subtrees,
+    // whose nodes are contiguous in every level
+    WaveletTreeLevelwise wt(hist,
+    [&](WaveletTree::bits_t& bits, const WaveletTreeBase&){
+        if(top_levels > 0) {
+            wt_nodes.merge_levels(ctx, bits, input, hist, true);
+        }
+        bits.resize(height);
+
+        for(size_t level = top_levels; level < height; level++) {
+            const size_t shift = level - top_levels;
+            const size_t first_node = 1ULL << shift;
+            const size_t last_node = 2ULL << shift;
+
+            size_t level_size = 0;
+            for(auto& nodes : sub_bits) {
+                for(size_t node_id = first_node; node_id < last_node; node_id++) {
+                    level_size += nodes[node_id-1].size();
+                }
+            }
+
+            auto& level_bv = bits[level];
+            level_bv.resize(level_size);
+
+            size_t offs = 0;
+            for(auto& nodes : sub_bits) {
+                for(size_t node_id = first_node; node_id < last_node; node_id++) {
+                    auto& bv = nodes[node_id-1];
+                    copy_bits(level_bv.data(), offs, bv.data(), 0, bv.size());
+                    offs += bv.size();
+
+                    bv.clear();
+                    bv.shrink_to_fit();
+                }
+            }
+        }
+
+        sub_bits.clear();
+        sub_bits.shrink_to_fit();
+    });
+
+    time.merge = dt();
+
+    // write levels to disk if needed, the level slices of the workers
+    // differ in size, so every level is written into a single file
+    const std::string& output = options.output;
+    if(output.length() > 0) {
+        ctx.synchronize();
+        ctx.cout_master() << "Writing WT to disk ..." << std::endl;
+
+        if(ctx.rank() == 0) {
+            hist.save(output + "." + WaveletTreeBase::histogram_extension());
+        }
+
+        wt.save_single_file(ctx, output);
+    }
+
+    // Synchronize for exit
+    ctx.cout_master() << "Waiting for exit signals ..." << std::endl;
+    ctx.synchronize();
+
+    // gather stats
+    Result result(
+        std::string("mpi-hybrid-") + shared_t::name(),
+        ctx, input, hist.size(), time);
+
+    ctx.cout_master() << result.readable() << std::endl
+                      << result.sqlplot() << std::endl;
+}
+
+};
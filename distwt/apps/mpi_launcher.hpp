@@ -1,83 +1,156 @@
 #pragma once
 
 #include <tlx/cmdline_parser.hpp>
+#include <distwt/apps/app_options.hpp>
+#include <distwt/apps/mpi_dd.hpp>
+#include <distwt/apps/mpi_hybrid.hpp>
+#include <distwt/apps/mpi_ls.hpp>
 #include <distwt/mpi/context.hpp>
 
 #include <distwt/mpi/uint_types.hpp>
 #include <src/validate_distwt.hpp>
 
-template<typename mpi_app_t>
+// runs the distributed algorithm selected on the command-line
+// with the given shared memory construction algorithm
+template<typename shared_t>
 int mpi_launch(int argc, char** argv) {
     // Read command-line
     tlx::CmdlineParser cp;
 
-    size_t rdbufsize = 0; // default to local input size
-    cp.add_bytes('r', "rbuf", rdbufsize, "File read buffer size.");
-
-    std::string output("");
-    cp.add_string('o', "output", output, "Name of output file.");
-
-    size_t prefix = SIZE_MAX; // default to whole file
-    cp.add_bytes('p', "prefix", prefix, "Only process prefix of input file.");
+    AppOptions options;
+    cp.add_bytes('r', "rbuf", options.rdbufsize, "File read buffer size.");
+    cp.add_string('o', "output", options.output, "Name of output file.");
+    cp.add_string('i', "hist", options.hist_filename,
+        "Use a previously saved histogram of the input, validated by one read pass.");
+    cp.add_bytes('p', "prefix", options.prefix, "Only process prefix of input file.");
+    cp.add_flag('m', "mmap", options.mmap_input,
+        "Memory-map the local input partition instead of reading it into RAM.");
+    cp.add_flag('s', "single-file", options.single_file,
+        "Write each level into a single file collectively.");
+    cp.add_flag('M', "matrix", options.matrix,
+        "Construct a wavelet matrix instead of a wavelet tree.");
+    cp.add_flag('e', "eff-input", options.eff_input,
+        "The input is already in the effective alphabet [0, sigma).");
+    cp.add_flag('P', "packed", options.packed,
+        "Bit-slice the effective text of balanced trees of small height (dd with ppc).");
+    cp.add_flag('H', "huffman", options.huffman,
+        "Construct a Huffman-shaped wavelet tree (dd), whose construction "
+        "processes every symbol once per bit of its code.");
+    cp.add_flag('S', "sparse-nodes", options.sparse_nodes,
+        "Store only the non-empty local nodes (dd, balanced trees), which is "
+        "the default for trees with more nodes than local input symbols.");
+
+    std::string algorithm = "dd";
+    cp.add_string('a', "algorithm", algorithm,
+        "Distributed algorithm: dd (domain decomposition, default), "
+        "hybrid (merged top levels, local subtrees) or "
+        "ls (levelwise split, no node-based intermediate).");
+    cp.add_size_t('k', "subtree-levels", options.subtree_levels,
+        "Number of merged top levels of the hybrid algorithm.");
 
     size_t sym_width = 1;
     cp.add_bytes('w', "width", sym_width, "Number of bytes per input symbol.");
 
-    // not implemented
-    const bool eff_input = false;
-
     bool validate_tree = false;
     cp.add_flag('v', "validate", validate_tree, "Validate the generated wavelet tree.");
 
-    std::string input_filename; // required
-    cp.add_param_string("file", input_filename, "The input file.");
+    // required
+    cp.add_param_string("file", options.input_filename, "The input file.");
     if (!cp.process(argc, argv)) {
         return -1;
     }
 
+    if(options.matrix && options.huffman) {
+        std::cerr << "Huffman-shaped wavelet matrices are not supported" << std::endl;
+        return -1;
+    }
+
+    if(options.eff_input && options.huffman) {
+        std::cerr << "Huffman codes require the histogram of the input" << std::endl;
+        return -1;
+    }
+
+    const bool hybrid = (algorithm == "hybrid");
+    const bool levelwise_split = (algorithm == "ls");
+    if(!hybrid && !levelwise_split && algorithm != "dd") {
+        std::cerr << "unknown algorithm: " << algorithm << std::endl;
+        return -1;
+    }
+
+    if(hybrid) {
+        if(options.matrix || options.huffman) {
+            std::cerr << "the hybrid algorithm only constructs balanced wavelet trees" << std::endl;
+            return -1;
+        }
+
+        // the workers own level slices of different sizes
+        options.single_file = true;
+    }
+
+    if(levelwise_split && (options.matrix || options.huffman)) {
+        std::cerr << "the levelwise split algorithm only constructs balanced wavelet trees" << std::endl;
+        return -1;
+    }
+
+    if(options.sparse_nodes && (algorithm != "dd" || options.matrix || options.huffman)) {
+        std::cerr << "sparse nodes are only supported for balanced wavelet trees by the dd algorithm" << std::endl;
+        return -1;
+    }
+
+    if(options.eff_input && algorithm != "dd") {
+        std::cerr << "effective input is only supported by the dd algorithm" << std::endl;
+        return -1;
+    }
+
     // Validation requires that we write the tree to the filesystem
-    validate_tree &= !output.empty();
+    validate_tree &= !options.output.empty();
+
+    const std::string& input_filename = options.input_filename;
+    const std::string& output = options.output;
+    const size_t prefix = options.prefix;
+    const bool single_file = options.single_file;
+    const bool matrix = options.matrix;
+    const bool huffman = options.huffman;
 
     // Init MPI
     MPIContext ctx(&argc, &argv);
 
+    auto start = [&](auto sym) {
+        using sym_t = decltype(sym);
+        if(hybrid) {
+            mpi_hybrid<shared_t>::template start<sym_t>(ctx, options);
+        } else if(levelwise_split) {
+            mpi_ls<shared_t>::template start<sym_t>(ctx, options);
+        } else {
+            mpi_dd<shared_t>::template start<sym_t>(ctx, options);
+        }
+    };
+
     // start
     switch(sym_width) {
         case 1:
-            mpi_app_t::template start<uint8_t>(
-                ctx,
-                input_filename, prefix, rdbufsize, eff_input,
-                output);
+            start(uint8_t());
             if(validate_tree && ctx.is_master()) {
-                validate_distwt<uint8_t>(input_filename, output, ctx.num_workers(), prefix);
+                validate_distwt<uint8_t>(input_filename, output, ctx.num_workers(), prefix, single_file, matrix, huffman);
             }
             return 0;
 
         case 2:
-            mpi_app_t::template start<uint16_t>(
-                ctx,
-                input_filename, prefix, rdbufsize, eff_input,
-                output);
+            start(uint16_t());
             if(validate_tree && ctx.is_master()) {
-                validate_distwt<uint16_t>(input_filename, output, ctx.num_workers(), prefix);
+                validate_distwt<uint16_t>(input_filename, output, ctx.num_workers(), prefix, single_file, matrix, huffman);
             }
             return 0;
 
         case 4:
-            mpi_app_t::template start<uint32_t>(
-                ctx,
-                input_filename, prefix, rdbufsize, eff_input,
-                output);
+            start(uint32_t());
             if(validate_tree && ctx.is_master()) {
-                validate_distwt<uint32_t>(input_filename, output, ctx.num_workers(), prefix);
+                validate_distwt<uint32_t>(input_filename, output, ctx.num_workers(), prefix, single_file, matrix, huffman);
             }
             return 0;
 
         case 5:
-            mpi_app_t::template start<uint40_t>(
-                ctx,
-                input_filename, prefix, rdbufsize, eff_input,
-                output);
+            start(uint40_t());
             if(validate_tree && ctx.is_master()) {
                 ctx.cout_master() << "can not validate tree for 5 byte input symbol width\n";
             }
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <limits>
+
+#include <omp.h>
+
+#include <distwt/apps/app_options.hpp>
+
+#include <distwt/common/util.hpp>
+
+#include <distwt/mpi/file_partition_reader.hpp>
+
+#include <distwt/mpi/histogram.hpp>
+#include <distwt/mpi/effective_alphabet.hpp>
+#include <distwt/mpi/bit_vector.hpp>
+#include <distwt/mpi/wt_levelwise.hpp>
+
+#include <distwt/mpi/result.hpp>
+
+#include <src/omp_write_bits.hpp>
+
+// levelwise split - every level is written from the current distributed
+// text order, which is then split stably by the symbols' next bit across the
+// workers, like a step of a distributed radix sort
+// only the text, a buffer of the same size and the levels are kept in memory,
+// there are no intermediate node bit vectors
+template<typename shared_t>
+class mpi_ls {
+public:
+
+template<typename sym_t>
+static void start(
+    MPIContext& ctx,
+    const AppOptions& options) {
+
+    Result::Time time;
+    double t0 = ctx.time();
+
+    auto dt = [&](){
+        const double t = ctx.time();
+        const double dt = t - t0;
+        t0 = t;
+        return dt;
+    };
+
+    const size_t num_workers = ctx.num_workers();
+
+    // Determine input partition
+    FilePartitionReader<sym_t> input(ctx, options.input_filename, options.prefix);
+    const size_t local_num = input.local_num();
+    const size_t rdbufsize = (options.rdbufsize > 0) ? options.rdbufsize : std::min(local_num, static_cast<size_t>(std::numeric_limits<int>::max()));
+    if(!options.mmap_input || !input.map()) {
+        input.buffer(rdbufsize);
+    }
+
+    time.input = dt();
+
+    // Compute histogram
+    ctx.cout_master() << "Compute histogram ..." << std::endl;
+    Histogram<sym_t> hist(ctx, input, rdbufsize, options.hist_filename);
+
+    time.hist = dt();
+
+    // Compute effective text
+    EffectiveAlphabet<sym_t> ea(hist);
+
+    std::vector<sym_t> text(local_num);
+    {
+        const sym_t* in = input.local_data();
+#pragma omp parallel for
+        for(size_t i = 0; i < local_num; i++) {
+            text[i] = ea.map(in[i]);
+        }
+    }
+    input.free();
+
+    std::vector<sym_t> buf(local_num);
+
+    time.eff = dt();
+
+    // Compute levels
+    const size_t sigma = hist.size();
+    const size_t height = WaveletTreeBase(hist).height();
+    const size_t bits_per_worker = input.size_per_worker();
+    const auto hist_c = hist.compute_C();
+
+    double time_exchange = 0;
+
+    // stable partition of the text by the nodes of the next level into buf,
+    // every thread counts and moves a contiguous slice of the text, and
+    // further threads are only used while their counters take at most one
+    // word per symbol, a single thread keeps one counter per node
+    const size_t max_threads = omp_get_max_threads();
+    auto partition = [&](const size_t shift, const size_t num_nodes) {
+        const size_t num_threads = std::max(size_t(1),
+            std::min(max_threads, local_num / num_nodes));
+        std::vector<uint64_t> thread_counts(num_threads * num_nodes, 0);
+
+#pragma omp parallel num_threads(num_threads)
+        {
+            const size_t t = omp_get_thread_num();
+            const size_t begin = t * local_num / num_threads;
+            const size_t end = (t+1) * local_num / num_threads;
+
+            uint64_t* counts = thread_counts.data() + t * num_nodes;
+            for(size_t i = begin; i < end; i++) {
+                ++counts[size_t(text[i]) >> shift];
+            }
+        }
+
+        // the total count of every node, the threads' offsets in node order
+        std::vector<uint64_t> counts(num_nodes);
+        {
+            uint64_t offs = 0;
+            for(size_t v = 0; v < num_nodes; v++) {
+                const uint64_t node_offs = offs;
+                for(size_t t = 0; t < num_threads; t++) {
+                    const uint64_t count = thread_counts[t * num_nodes + v];
+                    thread_counts[t * num_nodes + v] = offs;
+                    offs += count;
+                }
+                counts[v] = offs - node_offs;
+            }
+        }
+
+#pragma omp parallel num_threads(num_threads)
+        {
+            const size_t t = omp_get_thread_num();
+            const size_t begin = t * local_num / num_threads;
+            const size_t end = (t+1) * local_num / num_threads;
+
+            uint64_t* offs = thread_counts.data() + t * num_nodes;
+            for(size_t i = begin; i < end; i++) {
+                const sym_t c = text[i];
+                buf[offs[size_t(c) >> shift]++] = c;
+            }
+        }
+        return counts;
+    };
+
+    WaveletTreeLevelwise wt(hist,
+    [&](WaveletTree::bits_t& bits, const WaveletTreeBase&){
+        bits.resize(height);
+
+        for(size_t level = 0; level < height; level++) {
+            ctx.cout_master() << "level " << (level+1) << " ..." << std::endl;
+
+            // the text is in the order of the level's nodes
+            const size_t shift = height - 1 - level;
+
+            auto& level_bv = bits[level];
+            level_bv.resize(local_num);
+#pragma omp parallel
+            {
+                omp_extract_bits_vec(0, local_num, level_bv, text.data(), shift);
+            }
+
+            if(level + 1 == height) break;
+
+            // stable local partition by next level node, the targets are
+            // ascending in this order
+            const size_t num_next_nodes = 2ULL << level;
+            const std::vector<uint64_t> counts = partition(shift, num_next_nodes);
+
+            // global offsets of the local symbols in the next level's nodes,
+            // the local text is a contiguous part of the current level's
+            // node order, so only the first local node can have symbols on
+            // the preceding workers, namely on those whose last node it is
+            std::vector<uint64_t> node_offs(num_next_nodes, 0);
+            {
+                const size_t first_node = (local_num > 0) ? size_t(text.front()) >> (shift + 1) : 0;
+                const size_t last_node = (local_num > 0) ? size_t(text.back()) >> (shift + 1) : 0;
+
+                // whether the worker has symbols, its last node and the
+                // counts of that node's children
+                std::vector<uint64_t> local_last(4, 0);
+                if(local_num > 0) {
+                    local_last = { 1, last_node, counts[2 * last_node], counts[2 * last_node + 1] };
+                }
+                const auto all_last = ctx.all_gather(local_last);
+
+                for(size_t r = 0; r < ctx.rank(); r++) {
+                    const uint64_t* last = all_last.data() + 4 * r;
+                    if(last[0] && last[1] == first_node) {
+                        node_offs[2 * first_node] += last[2];
+                        node_offs[2 * first_node + 1] += last[3];
+                    }
+                }
+            }
+
+            std::vector<int> send_counts(num_workers, 0);
+            {
+                std::vector<size_t> send_sizes(num_workers, 0);
+                for(size_t v = 0; v < num_next_nodes; v++) {
+                    // split the node's global interval among the targets
+                    size_t p = size_t(hist_c[std::min(v << shift, sigma)]) + node_offs[v];
+                    const size_t q = p + counts[v];
+                    while(p < q) {
+                        const size_t target = p / bits_per_worker;
+                        const size_t x = std::min((target+1) * bits_per_worker, q);
+                        send_sizes[target] += x - p;
+                        p = x;
+                    }
+                }
+
+                for(size_t i = 0; i < num_workers; i++) {
+                    send_counts[i] = mpi_count(send_sizes[i]);
+                }
+            }
+
+            // exchange
+            const double t_exchange = ctx.time();
+            {
+                std::vector<int> send_displs(num_workers, 0);
+                for(size_t i = 1; i < num_workers; i++) {
+                    send_displs[i] = mpi_count(size_t(send_displs[i-1]) + size_t(send_counts[i-1]));
+                }
+
+                std::vector<int> recv_counts(num_workers);
+                ctx.alltoall(send_counts.data(), recv_counts.data(), 1);
+
+                std::vector<int> recv_displs(num_workers, 0);
+                for(size_t i = 1; i < num_workers; i++) {
+                    recv_displs[i] = mpi_count(size_t(recv_displs[i-1]) + size_t(recv_counts[i-1]));
+                }
+
+                assert(size_t(recv_displs.back()) + size_t(recv_counts.back()) == local_num);
+                ctx.alltoallv(
+                    buf.data(), send_counts, send_displs,
+                    text.data(), recv_counts, recv_displs);
+            }
+            time_exchange += ctx.time() - t_exchange;
+
+            // the blocks are received in rank order and every block is
+            // ordered by node, so a stable partition by node restores
+            // the global order
+            partition(shift, num_next_nodes);
+            std::swap(text, buf);
+        }
+    });
+
+    // Clean up
+    text.clear();
+    text.shrink_to_fit();
+    buf.clear();
+    buf.shrink_to_fit();
+
+    // Synchronize
+    ctx.cout_master() << "Done computing levels. Synchronizing ..." << std::endl;
+    ctx.synchronize();
+
+    // the exchanges account for the merge time
+    time.construct = dt() - time_exchange;
+    time.merge = time_exchange;
+
+    // write levels to disk if needed
+    const std::string& output = options.output;
+    if(output.length() > 0) {
+        ctx.synchronize();
+        ctx.cout_master() << "Writing WT to disk ..." << std::endl;
+
+        if(ctx.rank() == 0) {
+            hist.save(output + "." + WaveletTreeBase::histogram_extension());
+        }
+
+        if(options.single_file) {
+            wt.save_single_file(ctx, output);
+        } else {
+            wt.save(ctx, output);
+        }
+    }
+
+    // Synchronize for exit
+    ctx.cout_master() << "Waiting for exit signals ..." << std::endl;
+    ctx.synchronize();
+
+    // gather stats
+    Result result(
+        std::string("mpi-ls"),
+        ctx, input, hist.size(), time);
+
+    ctx.cout_master() << result.readable() << std::endl
+                      << result.sqlplot() << std::endl;
+}
+
+};
@@ -1,5 +0,0 @@
-#pragma once
-
-#include <bitset>
-
-using bv64_t = std::bitset<64>;
\ No newline at end of file
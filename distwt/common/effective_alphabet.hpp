@@ -1,27 +1,88 @@
 #pragma once
 
-#include <unordered_map>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include <tlx/math/integer_log2.hpp>
 
 #include <distwt/common/histogram.hpp>
 
+// maps symbols to their rank in the (sorted) histogram
+// symbols of up to 16 bits are mapped by a dense table, wider symbols by a
+// radix table over the most significant bits of the largest symbol followed
+// by a binary search in the sorted alphabet
 template<typename sym_t>
 class EffectiveAlphabetBase {
 protected:
-    std::unordered_map<sym_t, sym_t> m_map;
+    static constexpr bool DENSE = (sizeof(sym_t) <= 2);
+
+    static constexpr size_t RADIX_BITS = 16;
+
+    // dense: rank of every symbol
+    // otherwise: the sorted alphabet
+    std::vector<sym_t> m_table;
+
+    // first alphabet index of every radix bucket (not dense)
+    std::vector<size_t> m_buckets;
+
+    // the radix covers the top bits of the largest symbol (not dense)
+    size_t m_radix_shift = 0;
+
+    inline size_t bucket(const sym_t value) const {
+        return size_t(uint64_t(value) >> m_radix_shift);
+    }
 
 public:
     template<typename idx_t>
     inline EffectiveAlphabetBase(const HistogramBase<sym_t, idx_t>& hist) {
-        size_t i = 0;
-        for(auto e : hist.entries) {
-            m_map.emplace(e.first, sym_t(i++));
+        if constexpr(DENSE) {
+            m_table.resize(size_t(1) << (8 * sizeof(sym_t)), sym_t(0));
+
+            size_t i = 0;
+            for(auto e : hist.entries) {
+                m_table[size_t(e.first)] = sym_t(i++);
+            }
+        } else {
+            // histogram entries are sorted by symbol
+            m_table.reserve(hist.entries.size());
+            for(auto e : hist.entries) {
+                m_table.push_back(e.first);
+            }
+
+            if(!m_table.empty()) {
+                const uint64_t max_sym = uint64_t(m_table.back());
+                const size_t bits = (max_sym > 0)
+                    ? size_t(tlx::integer_log2_floor(max_sym)) + 1 : 0;
+                m_radix_shift = (bits > RADIX_BITS) ? bits - RADIX_BITS : 0;
+            }
+
+            m_buckets.resize((size_t(1) << RADIX_BITS) + 1, 0);
+            for(const sym_t x : m_table) {
+                ++m_buckets[bucket(x) + 1];
+            }
+            for(size_t b = 1; b < m_buckets.size(); b++) {
+                m_buckets[b] += m_buckets[b-1];
+            }
         }
     }
 
     inline ~EffectiveAlphabetBase() {
     }
 
+    // value must be contained in the histogram
     inline sym_t map(const sym_t value) const {
-        return m_map.at(value);
+        if constexpr(DENSE) {
+            return m_table[size_t(value)];
+        } else {
+            const size_t b = bucket(value);
+            const auto first = m_table.begin() + m_buckets[b];
+            const auto last = m_table.begin() + m_buckets[b+1];
+
+            const auto it = std::lower_bound(first, last, value);
+            assert(it != last && *it == value);
+            return sym_t(it - m_table.begin());
+        }
     }
-};
\ No newline at end of file
+};
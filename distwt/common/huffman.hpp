@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <distwt/common/binary_io.hpp>
+#include <distwt/common/histogram.hpp>
+
+// canonical Huffman code over the effective alphabet, which determines the
+// shape of a Huffman-shaped wavelet tree
+// the i-th histogram entry is encoded by code(i), whose length(i) bits are
+// stored in the least significant bits and which are read starting from the
+// most significant one, level by level
+// the code lengths are limited so that the tree stays close to the height of
+// the balanced tree and the padded codes fit into the input symbol type,
+// the limited code is still optimal under this limit (package-merge)
+class HuffmanCode {
+public:
+    // the maximum amount of levels added to the balanced tree height
+    static constexpr size_t MAX_EXTRA_LEVELS = 2;
+
+private:
+    size_t m_height;
+    std::vector<uint8_t> m_lengths;
+    std::vector<uint64_t> m_codes;
+
+    // computes the lengths of an optimal prefix code for the given
+    // frequencies, limited to max_length bits
+    // if the Huffman tree is deeper, the lengths are computed by
+    // package-merge, which is optimal among the length-limited codes
+    template<typename idx_t>
+    static std::vector<uint8_t> code_lengths(
+        const std::vector<idx_t>& freq, const size_t max_length) {
+
+        const size_t sigma = freq.size();
+        std::vector<uint8_t> lengths(sigma, 1);
+        if(sigma <= 1) return lengths;
+
+        // build the Huffman tree, internal nodes follow the leaves
+        std::vector<size_t> parent(2 * sigma - 1, 0);
+        {
+            using node_t = std::pair<size_t, size_t>; // weight, node
+            std::priority_queue<node_t, std::vector<node_t>, std::greater<node_t>> queue;
+            for(size_t i = 0; i < sigma; i++) {
+                queue.emplace(size_t(freq[i]), i);
+            }
+
+            for(size_t v = sigma; v < 2 * sigma - 1; v++) {
+                const node_t a = queue.top(); queue.pop();
+                const node_t b = queue.top(); queue.pop();
+                parent[a.second] = v;
+                parent[b.second] = v;
+                queue.emplace(a.first + b.first, v);
+            }
+        }
+
+        // parents are created after their children
+        std::vector<size_t> depth(2 * sigma - 1, 0);
+        size_t max_depth = 0;
+        for(size_t v = 2 * sigma - 2; v-- > 0;) {
+            depth[v] = depth[parent[v]] + 1;
+            if(v < sigma) max_depth = std::max(max_depth, depth[v]);
+        }
+
+        if(max_depth <= max_length) {
+            for(size_t i = 0; i < sigma; i++) {
+                lengths[i] = uint8_t(depth[i]);
+            }
+        } else {
+            // the symbols in order of increasing frequency
+            std::vector<size_t> order(sigma);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(),
+                [&](const size_t a, const size_t b){ return freq[a] < freq[b]; });
+
+            const auto limited = package_merge(freq, order, max_length);
+            for(size_t r = 0; r < sigma; r++) {
+                lengths[order[r]] = limited[r];
+            }
+        }
+        return lengths;
+    }
+
+    // package-merge [Larmore and Hirschberg, 1990] for the frequencies in
+    // the given increasing order, yields the length of the r-th symbol
+    // list j merges the symbols with the pairs of the first items of
+    // list j - 1, and every list is cut to the 2 sigma - 2 items that
+    // can be selected, the selected items of every list are a prefix of it
+    // and the symbols in it are the least frequent ones, each of which
+    // gains one bit per list, so only a flag per item is kept
+    template<typename idx_t>
+    static std::vector<uint8_t> package_merge(
+        const std::vector<idx_t>& freq,
+        const std::vector<size_t>& order,
+        const size_t max_length) {
+
+        const size_t sigma = order.size();
+        const size_t max_items = 2 * sigma - 2;
+
+        std::vector<std::vector<bool>> is_symbol(max_length);
+        std::vector<uint64_t> items, next;
+        for(size_t j = 0; j < max_length; j++) {
+            // merge the symbols with the packages of the previous list
+            next.clear();
+            size_t r = 0, p = 0;
+            const size_t num_packages = items.size() / 2;
+            auto& flags = is_symbol[j];
+            while(next.size() < max_items && (r < sigma || p < num_packages)) {
+                const uint64_t package = (p < num_packages)
+                    ? items[2 * p] + items[2 * p + 1] : UINT64_MAX;
+                if(r < sigma && uint64_t(freq[order[r]]) <= package) {
+                    next.push_back(uint64_t(freq[order[r++]]));
+                    flags.push_back(true);
+                } else {
+                    next.push_back(package);
+                    flags.push_back(false);
+                    ++p;
+                }
+            }
+            items.swap(next);
+        }
+
+        // select the 2 sigma - 2 items of the last list and follow the
+        // packages among them into the previous lists
+        std::vector<uint8_t> lengths(sigma, 0);
+        size_t num_selected = max_items;
+        for(size_t j = max_length; j-- > 0;) {
+            size_t num_symbols = 0;
+            for(size_t k = 0; k < num_selected; k++) {
+                num_symbols += is_symbol[j][k];
+            }
+            for(size_t r = 0; r < num_symbols; r++) {
+                ++lengths[r];
+            }
+            num_selected = 2 * (num_selected - num_symbols);
+        }
+        return lengths;
+    }
+
+    // assigns canonical codes to the current code lengths
+    void assign_codes() {
+        const size_t sigma = m_lengths.size();
+
+        std::vector<size_t> order(sigma);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+            [&](const size_t a, const size_t b){ return m_lengths[a] < m_lengths[b]; });
+
+        m_codes.resize(sigma);
+        m_height = 0;
+
+        uint64_t code = 0;
+        size_t length = 0;
+        for(const size_t i : order) {
+            code <<= (m_lengths[i] - length);
+            length = m_lengths[i];
+
+            m_codes[i] = code++;
+            m_height = length;
+        }
+    }
+
+public:
+    static inline std::string code_extension() {
+        return "huff";
+    }
+
+    inline HuffmanCode() : m_height(0) {
+    }
+
+    template<typename sym_t, typename idx_t>
+    inline HuffmanCode(const HistogramBase<sym_t, idx_t>& hist) {
+        const size_t sigma = hist.size();
+
+        // bits required to encode the effective alphabet
+        size_t balanced_height = 1;
+        while((uint64_t(1) << balanced_height) < sigma) ++balanced_height;
+
+        const size_t max_length = std::max(balanced_height,
+            std::min(balanced_height + MAX_EXTRA_LEVELS, 8 * sizeof(sym_t)));
+
+        std::vector<idx_t> freq;
+        freq.reserve(sigma);
+        for(const auto& e : hist.entries) {
+            freq.push_back(e.second);
+        }
+
+        m_lengths = code_lengths(freq, max_length);
+        assign_codes();
+    }
+
+    // loads a code table saved by save
+    inline HuffmanCode(const std::string& filename) {
+        binary::FileReader r(filename);
+
+        const size_t sigma = r.template read<size_t>();
+        m_lengths.reserve(sigma);
+        for(size_t i = 0; i < sigma; i++) {
+            m_lengths.push_back(r.template read<uint8_t>());
+        }
+
+        assign_codes();
+    }
+
+    // the height of the Huffman-shaped tree
+    inline size_t height() const { return m_height; }
+
+    inline size_t sigma() const { return m_lengths.size(); }
+
+    inline size_t length(const size_t i) const { return m_lengths[i]; }
+
+    inline uint64_t code(const size_t i) const { return m_codes[i]; }
+
+    // the code padded with zeros to the tree height, i.e., the symbol that
+    // follows the code's path in a balanced tree of the same height
+    inline uint64_t padded(const size_t i) const {
+        return m_codes[i] << (m_height - m_lengths[i]);
+    }
+
+    // computes the global size of every node of the Huffman-shaped tree,
+    // using the node layout of a balanced tree of the same height
+    // nodes below the leaves of the Huffman tree have size zero
+    template<typename sym_t, typename idx_t>
+    std::vector<idx_t> node_sizes(const HistogramBase<sym_t, idx_t>& hist) const {
+        std::vector<idx_t> sizes((1ULL << m_height) - 1ULL, idx_t(0));
+
+        for(size_t i = 0; i < m_lengths.size(); i++) {
+            const idx_t count = hist.entries[i].second;
+            const size_t len = m_lengths[i];
+
+            size_t node_id = 1;
+            for(size_t d = 0; d < len; d++) {
+                sizes[node_id - 1] += count;
+                node_id = 2 * node_id + ((m_codes[i] >> (len - d - 1)) & 1ULL);
+            }
+        }
+        return sizes;
+    }
+
+    // saves the code lengths, from which the canonical codes follow
+    void save(const std::string& filename) const {
+        binary::FileWriter w(filename);
+
+        w.write<size_t>(m_lengths.size()); // num entries
+        for(const uint8_t len : m_lengths) {
+            w.write<uint8_t>(len);
+        }
+    }
+};
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <fstream>
+#include <type_traits>
 #include <vector>
 
 #include <sys/stat.h>
 
+#include <distwt/mpi/bit_vector.hpp>
+
 namespace util {
 
 inline size_t file_size(const std::string& filename) {
@@ -19,6 +23,45 @@ inline size_t file_size(const std::string& filename) {
     return buf.st_size;
 }
 
+// calls func with a value of the narrowest unsigned type that holds
+// symbols of the given amount of bits, but at most of type sym_t
+template<typename sym_t, typename func_t>
+inline void with_narrowest_uint(const size_t bits, func_t func) {
+    if constexpr(sizeof(sym_t) > 1) {
+        if(bits <= 8) {
+            func(uint8_t());
+            return;
+        }
+    }
+    if constexpr(sizeof(sym_t) > 2) {
+        if(bits <= 16) {
+            func(uint16_t());
+            return;
+        }
+    }
+    if constexpr(sizeof(sym_t) > 4) {
+        if(bits <= 32) {
+            func(uint32_t());
+            return;
+        }
+    }
+    func(sym_t());
+}
+
+// calls func(std::integral_constant<size_t, h>()) for a height h of at most
+// max_height, so that func can instantiate code for a compile-time height,
+// and func(std::integral_constant<size_t, 0>()) for any other height
+template<size_t max_height, typename func_t>
+inline void with_height(const size_t h, func_t func) {
+    if constexpr(max_height == 0) {
+        func(std::integral_constant<size_t, 0>());
+    } else if(h == max_height) {
+        func(std::integral_constant<size_t, max_height>());
+    } else {
+        with_height<max_height - 1>(h, func);
+    }
+}
+
 inline double time() {
     using namespace std::chrono;
     return double(duration_cast<milliseconds>(
@@ -29,10 +72,10 @@ inline double time() {
 
 // stream output for bit vectors
 inline std::ostream& operator<<(
-    std::ostream& os, const std::vector<bool>& bv) {
+    std::ostream& os, const bv_t& bv) {
 
-    for(bool b : bv) {
-        os << (b ? '1' : '0');
+    for(size_t i = 0; i < bv.size(); i++) {
+        os << (bv[i] ? '1' : '0');
     }
 
     return os;
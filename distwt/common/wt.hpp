@@ -13,7 +13,8 @@ protected:
     size_t m_height;
 
     static inline size_t wt_height(const size_t sigma) {
-        return tlx::integer_log2_ceil(sigma - 1);
+        // bits of the largest effective symbol sigma - 1
+        return tlx::integer_log2_ceil(sigma);
     }
 
     static inline size_t max_bintree_nodes(const size_t height) {
@@ -45,7 +46,11 @@ public:
         const size_t num_nodes = max_bintree_nodes(wt_height(hist.size()));
         std::vector<idx_t> sizes(num_nodes);
 
+        // C always has an entry past the last symbol, which the compiler
+        // cannot see when it inlines the index arithmetic below
         auto c = hist.compute_C();
+        if(c.empty()) return sizes;
+
         recursive_node_sizes(sizes, c, 1, 0, num_nodes);
 
         return sizes;
@@ -69,6 +74,13 @@ public:
           m_height(wt_height(hist.size())) {
     }
 
+    // a tree of the given height, e.g., a Huffman-shaped tree
+    template<typename sym_t, typename idx_t>
+    inline WaveletTreeBase(const HistogramBase<sym_t, idx_t>& hist, const size_t height)
+        : m_sigma(hist.size()),
+          m_height(height) {
+    }
+
     inline size_t sigma() const { return m_sigma; }
     inline size_t height() const { return m_height; }
     inline size_t num_nodes() const { return max_bintree_nodes(m_height); }
@@ -2,20 +2,26 @@
 
 #include <distwt/common/effective_alphabet.hpp>
 #include <distwt/common/wt.hpp>
+#include <distwt/mpi/bit_vector.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <tlx/math/integer_log2.hpp>
 
 // one bit vector per node
-using wt_bits_t = std::vector<std::vector<bool>>;
+using wt_bits_t = std::vector<bv_t>;
 
-// prefix counting for wavelet subtree
+// prefix counting for wavelet subtree, using the given counters for 2^h
+// symbols and 2^(h-1) nodes, it allocates nothing if the node bit vectors
+// already have their final sizes
 template<typename sym_t, typename idx_t>
 inline void wt_pc(
     wt_bits_t& bits,
     const std::vector<sym_t>& text,
     const size_t root_node_id, // 1-based!!
-    const size_t h) {
+    const size_t h,
+    idx_t* hist,
+    idx_t* count) {
 
     assert(root_node_id > 0);
     const size_t root_level = tlx::integer_log2_floor(root_node_id);
@@ -28,7 +34,7 @@ inline void wt_pc(
     assert(h >= 1);
 
     // compute histogram and root node
-    std::vector<idx_t> hist(sigma);
+    std::fill(hist, hist + sigma, idx_t(0));
     {
         const size_t test = 1ULL << (glob_h - 1 - root_level);
 
@@ -49,7 +55,6 @@ inline void wt_pc(
     }
 
     // compute the rest bottom-up
-    std::vector<idx_t> count(sigma/2); // allocate counters
     for(size_t level = h-1; level > 0; --level) {
         const size_t num_level_nodes = (1ULL << level);
         //const size_t first_level_node = num_level_nodes - 1;
@@ -90,6 +95,19 @@ inline void wt_pc(
     }
 }
 
+// prefix counting for wavelet subtree
+template<typename sym_t, typename idx_t>
+inline void wt_pc(
+    wt_bits_t& bits,
+    const std::vector<sym_t>& text,
+    const size_t root_node_id, // 1-based!!
+    const size_t h) {
+
+    std::vector<idx_t> hist(1ULL << h);
+    std::vector<idx_t> count(1ULL << (h-1)); // allocate counters
+    wt_pc<sym_t, idx_t>(bits, text, root_node_id, h, hist.data(), count.data());
+}
+
 // prefix counting
 template<typename sym_t, typename idx_t>
 inline void wt_pc(
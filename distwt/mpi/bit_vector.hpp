@@ -1,5 +1,161 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
-using bv_t = std::vector<bool>;
\ No newline at end of file
+#include <src/alignment_allocator.hpp>
+#include <src/bit_extract.hpp>
+
+// bit vector stored in cache line aligned 64-bit words
+// bit i is stored in word i / 64, starting from the most significant bit,
+// which is the layout of the pwm bit vectors and of the saved levels
+class BitVector {
+public:
+    using word_t = uint64_t;
+
+    static constexpr size_t WORD_BITS = 64;
+
+    static constexpr size_t num_words(const size_t num_bits) {
+        return (num_bits + WORD_BITS - 1) / WORD_BITS;
+    }
+
+    static constexpr word_t mask(const size_t i) {
+        return word_t(1) << (WORD_BITS - 1 - (i % WORD_BITS));
+    }
+
+    class reference {
+    private:
+        word_t* m_word;
+        word_t m_mask;
+
+    public:
+        inline reference(word_t* word, const word_t mask) : m_word(word), m_mask(mask) {
+        }
+
+        inline operator bool() const {
+            return (*m_word & m_mask) != 0;
+        }
+
+        inline reference& operator=(const bool b) {
+            if(b) {
+                *m_word |= m_mask;
+            } else {
+                *m_word &= ~m_mask;
+            }
+            return *this;
+        }
+
+        inline reference& operator=(const reference& other) {
+            return (*this = bool(other));
+        }
+    };
+
+private:
+    std::vector<word_t, Alignment_allocator<word_t>> m_words;
+    size_t m_size;
+
+public:
+    inline BitVector() : m_size(0) {
+    }
+
+    inline BitVector(const size_t size) : m_words(num_words(size), 0), m_size(size) {
+    }
+
+    inline size_t size() const { return m_size; }
+    inline bool empty() const { return m_size == 0; }
+    inline size_t num_words() const { return m_words.size(); }
+
+    inline word_t* data() { return m_words.data(); }
+    inline const word_t* data() const { return m_words.data(); }
+
+    // new bits are zero, bits beyond the size are kept zero
+    inline void resize(const size_t size) {
+        m_words.resize(num_words(size), 0);
+        if(size < m_size && (size % WORD_BITS)) {
+            m_words.back() &= UINT64_MAX << (WORD_BITS - size % WORD_BITS);
+        }
+        m_size = size;
+    }
+
+    inline void clear() {
+        m_words.clear();
+        m_size = 0;
+    }
+
+    inline void shrink_to_fit() {
+        m_words.shrink_to_fit();
+    }
+
+    inline void push_back(const bool b) {
+        resize(m_size + 1);
+        (*this)[m_size - 1] = b;
+    }
+
+    inline bool operator[](const size_t i) const {
+        return (m_words[i / WORD_BITS] & mask(i)) != 0;
+    }
+
+    inline reference operator[](const size_t i) {
+        return reference(&m_words[i / WORD_BITS], mask(i));
+    }
+};
+
+using bv_t = BitVector;
+
+// reads up to 64 bits starting at bit offs, aligned to the most significant bit
+// bits following the requested ones are undefined
+inline uint64_t read_bits(const uint64_t* src, const size_t offs, const size_t num) {
+    const size_t w = offs / 64;
+    const size_t s = offs % 64;
+
+    uint64_t x = src[w] << s;
+    if(s + num > 64) {
+        x |= src[w + 1] >> (64 - s);
+    }
+    return x;
+}
+
+// counts the set bits among the num bits starting at bit offs
+inline size_t count_ones(const uint64_t* src, size_t offs, size_t num) {
+    size_t ones = 0;
+    if(offs % 64 && num > 0) {
+        const size_t k = std::min(num, 64 - offs % 64);
+        ones += __builtin_popcountll(read_bits(src, offs, k) >> (64 - k));
+
+        offs += k;
+        num -= k;
+    }
+
+    ones += bit_extract::popcount_words(src + offs / 64, num / 64);
+    if(num % 64) {
+        ones += __builtin_popcountll(src[(offs + num) / 64] >> (64 - num % 64));
+    }
+    return ones;
+}
+
+// copies num bits from src starting at bit src_offs to dst starting at bit
+// dst_offs, working on whole words - bits of dst outside of the target
+// interval are left untouched
+inline void copy_bits(
+    uint64_t* dst,
+    size_t dst_offs,
+    const uint64_t* src,
+    size_t src_offs,
+    size_t num) {
+
+    while(num > 0) {
+        const size_t s = dst_offs % 64;
+        const size_t k = std::min(num, 64 - s);
+
+        const uint64_t mask = (UINT64_MAX << (64 - k)) >> s;
+        const uint64_t x = read_bits(src, src_offs, k) >> s;
+
+        uint64_t& w = dst[dst_offs / 64];
+        w = (w & ~mask) | (x & mask);
+
+        dst_offs += k;
+        src_offs += k;
+        num -= k;
+    }
+}
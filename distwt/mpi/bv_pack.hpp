@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstring>
+
+#include <distwt/mpi/bit_vector.hpp>
+
+// packs bit intervals into words that are aligned to the word grid of the
+// target bit vector, so that they can be placed by copying whole words
+class bv_pack_t {
+public:
+    // number of words required to pack num bits that go to bit dst_offs
+    static inline size_t required_bufsize(const size_t dst_offs, const size_t num) {
+        return bv_t::num_words(dst_offs % 64 + num);
+    }
+
+    // packs the bits [src_offs, src_offs + num) of src so that they
+    // can be placed at bit dst_offs, dst must be zeroed
+    static inline void pack(
+        const uint64_t* src,
+        const size_t src_offs,
+        uint64_t* dst,
+        const size_t dst_offs,
+        const size_t num) {
+
+        copy_bits(dst, dst_offs % 64, src, src_offs, num);
+    }
+
+    static inline void pack(
+        const bv_t& src,
+        const size_t src_offs,
+        uint64_t* dst,
+        const size_t dst_offs,
+        const size_t num) {
+
+        pack(src.data(), src_offs, dst, dst_offs, num);
+    }
+
+    // places packed bits at bit dst_offs of dst, which must not have been set
+    // the boundary words are merged atomically, so that disjoint
+    // intervals can be unpacked concurrently
+    static inline void unpack(
+        const uint64_t* src,
+        bv_t& dst,
+        const size_t dst_offs,
+        const size_t num) {
+
+        uint64_t* words = dst.data() + dst_offs / 64;
+
+        size_t first = 0;
+        size_t last = required_bufsize(dst_offs, num);
+
+        if(dst_offs % 64) {
+            __atomic_fetch_or(&words[first], src[first], __ATOMIC_RELAXED);
+            ++first;
+        }
+
+        if(last > first && (dst_offs + num) % 64) {
+            --last;
+            __atomic_fetch_or(&words[last], src[last], __ATOMIC_RELAXED);
+        }
+
+        std::memcpy(words + first, src + first, (last - first) * sizeof(uint64_t));
+    }
+};
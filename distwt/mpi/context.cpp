@@ -139,6 +139,21 @@ void MPIContext::synchronize() {
     MPI_Barrier(m_comm);
 }
 
+size_t MPIContext::wait_any(std::vector<MPI_Request>& reqs) {
+    int index;
+    MPI_Waitany(reqs.size(), reqs.data(), &index, MPI_STATUS_IGNORE);
+    return size_t(index);
+}
+
+std::vector<size_t> MPIContext::test_some(std::vector<MPI_Request>& reqs) {
+    std::vector<int> indices(reqs.size());
+    int num;
+    MPI_Testsome(reqs.size(), reqs.data(), &num, indices.data(), MPI_STATUSES_IGNORE);
+
+    // MPI_UNDEFINED if there are no active requests
+    return std::vector<size_t>(indices.begin(), indices.begin() + std::max(num, 0));
+}
+
 size_t MPIContext::gather_max_alloc() const {
     size_t glob;
     MPI_Allreduce(&m_alloc_max, &glob, 1,
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cassert>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 #include <vector>
 
 #include <tlx/math/integer_log2.hpp>
@@ -13,6 +16,15 @@
 #include <distwt/mpi/mpi_sum.hpp>
 #include <distwt/mpi/mpi_type.hpp>
 
+// narrows a count or displacement of a collective to the int that MPI takes,
+// larger values would wrap silently
+inline int mpi_count(const size_t x) {
+    if(x > size_t(std::numeric_limits<int>::max())) {
+        throw std::overflow_error("MPI count exceeds INT_MAX");
+    }
+    return int(x);
+}
+
 class MPIContext {
 private:
     static util::devnull m_devnull;
@@ -219,6 +231,70 @@ public:
         v = rbuf;
     }
 
+    template<typename T>
+    inline std::vector<T> all_gather(const std::vector<T>& v) {
+        std::vector<T> rbuf(v.size() * m_num_workers);
+        const int count = mpi_count(v.size());
+        MPI_Allgather(v.data(), count, mpi_type<T>::id(),
+            rbuf.data(), count, mpi_type<T>::id(), m_comm);
+
+        for(size_t i = 0; i < m_num_workers; i++) {
+            count_traffic_tx(i, v.size() * sizeof(T));
+            count_traffic_rx(i, v.size() * sizeof(T));
+        }
+        return rbuf;
+    }
+
+    template<typename T>
+    void alltoall(const T* sbuf, T* rbuf, size_t num) {
+        const int count = mpi_count(num);
+        MPI_Alltoall(sbuf, count, mpi_type<T>::id(),
+            rbuf, count, mpi_type<T>::id(), m_comm);
+
+        for(size_t i = 0; i < m_num_workers; i++) {
+            count_traffic_tx(i, num * sizeof(T));
+            count_traffic_rx(i, num * sizeof(T));
+        }
+    }
+
+    template<typename T>
+    void alltoallv(
+        const T* sbuf, const std::vector<int>& scounts, const std::vector<int>& sdispls,
+        T* rbuf, const std::vector<int>& rcounts, const std::vector<int>& rdispls) {
+
+        MPI_Alltoallv(
+            sbuf, scounts.data(), sdispls.data(), mpi_type<T>::id(),
+            rbuf, rcounts.data(), rdispls.data(), mpi_type<T>::id(), m_comm);
+
+        for(size_t i = 0; i < m_num_workers; i++) {
+            count_traffic_tx(i, scounts[i] * sizeof(T));
+            count_traffic_rx(i, rcounts[i] * sizeof(T));
+        }
+    }
+
+    template<typename T>
+    MPI_Request ialltoallv(
+        const T* sbuf, const std::vector<int>& scounts, const std::vector<int>& sdispls,
+        T* rbuf, const std::vector<int>& rcounts, const std::vector<int>& rdispls) {
+
+        MPI_Request req;
+        MPI_Ialltoallv(
+            sbuf, scounts.data(), sdispls.data(), mpi_type<T>::id(),
+            rbuf, rcounts.data(), rdispls.data(), mpi_type<T>::id(), m_comm, &req);
+
+        for(size_t i = 0; i < m_num_workers; i++) {
+            count_traffic_tx(i, scounts[i] * sizeof(T));
+            count_traffic_rx(i, rcounts[i] * sizeof(T));
+        }
+        return req;
+    }
+
+    // waits for any of the requests to complete and returns its index
+    size_t wait_any(std::vector<MPI_Request>& reqs);
+
+    // returns the indices of all requests that have completed
+    std::vector<size_t> test_some(std::vector<MPI_Request>& reqs);
+
 private:
     inline void simulate_scan_traffic(const size_t msg_size) {
         // simulates the scan operation for traffic measurement
@@ -274,5 +350,40 @@ public:
         simulate_scan_traffic(sizeof(int) + v.size() * sizeof(T));
     }
 
+private:
+    inline void simulate_bcast_traffic(const size_t root, const size_t msg_size) {
+        // simulates the broadcast operation for traffic measurement
+        // based on the binomial tree algorithm
+        const size_t r = (m_rank + m_num_workers - root) % m_num_workers;
+        for(size_t q = 1; q < m_num_workers; q *= 2) {
+            if(r < q) {
+                // I send a message to my child on this level
+                if(r + q < m_num_workers) {
+                    count_traffic_tx_est((m_rank + q) % m_num_workers, msg_size);
+                }
+            } else if(r < 2 * q) {
+                // I receive a message from my parent
+                count_traffic_rx_est((m_rank + m_num_workers - q) % m_num_workers, msg_size);
+            }
+        }
+    }
+
+public:
+    template<typename T>
+    inline void bcast(T* buf, size_t num, size_t root) {
+        assert(root < m_num_workers);
+        MPI_Bcast(buf, mpi_count(num), mpi_type<T>::id(), int(root), m_comm);
+        simulate_bcast_traffic(root, num * sizeof(T));
+    }
+
+    // broadcasts the root's vector, which may have any size
+    template<typename T>
+    inline void bcast(std::vector<T>& v, size_t root) {
+        uint64_t num = v.size();
+        bcast(&num, 1, root);
+        v.resize(num);
+        bcast(v.data(), num, root);
+    }
+
     void synchronize();
 };
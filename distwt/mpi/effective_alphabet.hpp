@@ -16,7 +16,7 @@ public:
 
         // compute effective transformation and call processor for each symbol
         input.process_local([&](sym_t c){
-            processor(this->m_map.at(c));
+            processor(this->map(c));
         }, rdbufsize);
     }
 };
\ No newline at end of file
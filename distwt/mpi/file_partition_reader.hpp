@@ -3,6 +3,9 @@
 #include <tlx/math/div_ceil.hpp>
 #include <mpi.h>
 #include <omp.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <pwm/util/debug_assert.hpp>
 #include <pwm/util/common.hpp>
 
@@ -27,6 +30,15 @@ private:
     bool m_buffered;
     std::vector<sym_t> m_buffer;
 
+    bool m_mapped;
+    void* m_map_addr;
+    size_t m_map_len;
+
+    // local symbols if buffered or mapped
+    const sym_t* m_data;
+
+    inline bool in_memory() const { return m_buffered || m_mapped; }
+
 public:
     inline FilePartitionReader(
         const MPIContext& ctx,
@@ -36,7 +48,11 @@ public:
           m_filename(filename),
           m_rank(ctx.rank()),
           m_extracted(false),
-          m_buffered(false) {
+          m_buffered(false),
+          m_mapped(false),
+          m_map_addr(nullptr),
+          m_map_len(0),
+          m_data(nullptr) {
 
         const size_t w = sizeof(sym_t);
         const size_t filesize = util::file_size(m_filename);
@@ -59,6 +75,13 @@ public:
         m_local_num = local_end - m_local_offset;
     }
 
+    FilePartitionReader(const FilePartitionReader&) = delete;
+    FilePartitionReader& operator=(const FilePartitionReader&) = delete;
+
+    inline ~FilePartitionReader() {
+        free();
+    }
+
     inline const std::string& filename() const { return m_filename; }
     inline size_t total_size() const { return m_total_size; }
     inline size_t size_per_worker() const { return m_size_per_worker; }
@@ -66,6 +89,9 @@ public:
     inline size_t local_offset() const { return m_local_offset; }
     inline size_t local_num() const { return m_local_num; }
 
+    // local symbols, only available after buffer() or map()
+    inline const sym_t* local_data() const { return m_data; }
+
     bool extract_local(const std::string& local_filename, size_t bufsize) {
         if(!m_extracted) {
             m_local_filename = local_filename + ".part." + std::to_string(m_rank);
@@ -118,9 +144,27 @@ public:
     void process_local(
         std::function<void(sym_t)> func, size_t bufsize) const {
 
-        if(m_buffered) {
-            for(sym_t x : m_buffer) {
-                func(x);
+        if(in_memory()) {
+            for(size_t i = 0; i < m_local_num; i++) {
+                func(m_data[i]);
+            }
+        } else {
+            process_local_blocks([&](const sym_t* block, const size_t num){
+                for(size_t i = 0; i < num; i++) {
+                    func(block[i]);
+                }
+            }, bufsize);
+        }
+    }
+
+    // passes the local symbols in consecutive blocks of up to bufsize
+    // symbols, which point into the local data if it is in memory
+    void process_local_blocks(
+        std::function<void(const sym_t*, size_t)> func, size_t bufsize) const {
+
+        if(in_memory()) {
+            for(size_t i = 0; i < m_local_num; i += bufsize) {
+                func(m_data + i, std::min(bufsize, m_local_num - i));
             }
         } else {
 
@@ -158,10 +202,7 @@ public:
                 while(left) {
                     const size_t num = std::min(bufsize, left);
                     MPI_File_read(f, buf.data(), num, mpi_type<sym_t>::id(), &status);
-
-                    for(size_t i = 0; i < num; i++) {
-                        func(buf[i]);
-                    }
+                    func(buf.data(), num);
 
                     left -= num;
                 }
@@ -174,25 +215,25 @@ public:
     }
 
     void process_local_omp(std::function<void(size_t, sym_t)> func, size_t bufsize) const {
-        if(m_buffered) {
+        if(in_memory()) {
 #pragma omp for
-            for (int64_t scur_pos = 0; scur_pos <= (int64_t(m_buffer.size()) - CACHELINE_SIZE); scur_pos += CACHELINE_SIZE) {
+            for (int64_t scur_pos = 0; scur_pos <= (int64_t(m_local_num) - CACHELINE_SIZE); scur_pos += CACHELINE_SIZE) {
                 DCHECK(scur_pos >= 0);
                 for (size_t i = 0; i < CACHELINE_SIZE; i++) {
                     const size_t idx = scur_pos + i;
-                    func(idx, m_buffer[idx]);
+                    func(idx, m_data[idx]);
                 }
             }
 
             const auto omp_rank = omp_get_thread_num();
             const auto omp_size = omp_get_num_threads();
 
-            uint64_t const remainder = m_buffer.size() & (CACHELINE_SIZE-1ULL);
+            uint64_t const remainder = m_local_num & (CACHELINE_SIZE-1ULL);
             if (remainder && ((omp_rank + 1) == omp_size)) {
-                const auto scur_pos = m_buffer.size() - remainder;
+                const auto scur_pos = m_local_num - remainder;
                 for (size_t i = 0; i < remainder; i++) {
                     const size_t idx = scur_pos + i;
-                    func(idx, m_buffer[idx]);
+                    func(idx, m_data[idx]);
                 }
             }
         }else{
@@ -207,22 +248,69 @@ public:
     }
 
     void buffer(size_t bufsize) {
-        if(!m_buffered) {
+        if(!in_memory()) {
             m_buffer.reserve(m_local_num);
             
             process_local([&](const sym_t x){
                 m_buffer.push_back(x);
             }, bufsize);
 
+            m_data = m_buffer.data();
             m_buffered = true;
         }
     }
 
+    // maps the local partition into memory, so it is served directly from
+    // the page cache instead of being copied into a buffer
+    // returns false if the file could not be mapped
+    bool map() {
+        if(in_memory()) return true;
+
+        const size_t page_size = sysconf(_SC_PAGESIZE);
+        const size_t offs = m_local_offset * sizeof(sym_t);
+        const size_t page_offs = offs % page_size;
+
+        if(m_local_num > 0) {
+            const int fd = open(m_filename.c_str(), O_RDONLY);
+            if(fd < 0) return false;
+
+            m_map_len = page_offs + m_local_num * sizeof(sym_t);
+            m_map_addr = mmap(
+                nullptr, m_map_len, PROT_READ, MAP_PRIVATE, fd, offs - page_offs);
+            close(fd);
+
+            if(m_map_addr == MAP_FAILED) {
+                m_map_addr = nullptr;
+                m_map_len = 0;
+                return false;
+            }
+
+            // the partition is scanned front to back
+            madvise(m_map_addr, m_map_len, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+            madvise(m_map_addr, m_map_len, MADV_HUGEPAGE);
+#endif
+
+            m_data = reinterpret_cast<const sym_t*>(
+                static_cast<const char*>(m_map_addr) + page_offs);
+        }
+
+        m_mapped = true;
+        return true;
+    }
+
     void free() {
         if(m_buffered) {
             m_buffer.clear();
             m_buffer.shrink_to_fit();
             m_buffered = false;
         }
+        if(m_mapped) {
+            if(m_map_addr) munmap(m_map_addr, m_map_len);
+            m_map_addr = nullptr;
+            m_map_len = 0;
+            m_mapped = false;
+        }
+        m_data = nullptr;
     }
 };
\ No newline at end of file
@@ -7,11 +7,10 @@
 #include <distwt/mpi/file_partition_reader.hpp>
 
 #include <distwt/common/util.hpp>
-#include <distwt/mpi/util.hpp>
 #include <distwt/mpi/types.hpp>
 
 #include <algorithm>
-#include <tlx/math/integer_log2.hpp>
+#include <fstream>
 
 #include <omp.h>
 
@@ -33,154 +32,407 @@ public:
         this->load(filename);
     }
 
-private:
-    // base implementation for arbritrary alphabets
-    inline void compute_histogram(
+    // uses the histogram saved in the given file if it matches the input,
+    // and computes the histogram otherwise (or if no file is given)
+    inline Histogram(
+        MPIContext& ctx,
+        const FilePartitionReader<sym_t>& input,
+        const size_t rdbufsize,
+        const std::string& filename) {
+
+        if(!filename.empty()) {
+            load_and_broadcast(ctx, filename);
+            if(matches(ctx, input, rdbufsize)) return;
+
+            ctx.cout_master() << "Histogram " << filename
+                << " does not match the input, recomputing ..." << std::endl;
+            this->m_entries.clear();
+        }
+
+        compute_histogram(ctx, input, rdbufsize);
+    }
+
+    // histogram of an input that is already in the effective alphabet
+    // [0, sigma), whose counts are set by reduce_counts
+    inline Histogram(const size_t sigma) {
+        this->m_entries.reserve(sigma);
+        for(size_t c = 0; c < sigma; c++) {
+            this->m_entries.emplace_back(sym_t(c), idx_t(0));
+        }
+    }
+
+    // determines the alphabet size of an input that is already in the
+    // effective alphabet from its maximum symbol
+    static size_t effective_sigma(
         MPIContext& ctx,
         const FilePartitionReader<sym_t>& input,
         const size_t rdbufsize) {
 
+        uint64_t local_max = 0;
+#pragma omp parallel reduction(max : local_max)
         {
-            // compute local histogram
-            std::vector<std::unordered_map<sym_t, idx_t>> sharded_hists(omp_get_max_threads());
-
-            const auto map_inserter = [](std::unordered_map<sym_t, idx_t>& map, const sym_t c, const idx_t num = 1) {
-                auto it = map.find(c);
-                if(it != map.end()) {
-                    it->second += num;
-                } else {
-                    map.emplace(c, num);
-                }
+            input.process_local_omp([&](const size_t, sym_t c){
+                local_max = std::max(local_max, uint64_t(c));
+            }, rdbufsize);
+        }
+
+        uint64_t max = 0;
+        ctx.all_reduce(&local_max, &max, 1, MPI_MAX);
+        return size_t(max) + 1;
+    }
+
+    // sets the counts to the sums of all workers' local counts
+    void reduce_counts(MPIContext& ctx, const std::vector<uint64_t>& local_counts) {
+        std::vector<uint64_t> counts(local_counts.size());
+        ctx.all_reduce(local_counts.data(), counts.data(), counts.size());
+
+        for(size_t c = 0; c < this->m_entries.size(); c++) {
+            this->m_entries[c].second = idx_t(counts[c]);
+        }
+    }
+
+    // tells whether the alphabet is [0, sigma), i.e., the effective one
+    bool is_effective() const {
+        return this->m_entries.empty() ||
+            size_t(this->m_entries.back().first) + 1 == this->m_entries.size();
+    }
+
+private:
+    using entry_t = typename HistogramBase<sym_t, idx_t>::entry_t;
+
+    // loads the histogram on the root and broadcasts it to all workers
+    void load_and_broadcast(MPIContext& ctx, const std::string& filename) {
+        std::vector<sym_t> syms;
+        std::vector<idx_t> occs;
+        if(ctx.is_master() && std::ifstream(filename).good()) {
+            this->load(filename);
+            for(const auto& e : this->m_entries) {
+                syms.push_back(e.first);
+                occs.push_back(e.second);
+            }
+        }
+
+        ctx.bcast(syms, 0);
+        ctx.bcast(occs, 0);
+
+        this->m_entries.clear();
+        this->m_entries.reserve(syms.size());
+        for(size_t i = 0; i < syms.size(); i++) {
+            this->m_entries.emplace_back(syms[i], occs[i]);
+        }
+    }
+
+    // mixes the bits of a symbol, so that the sums of the hashes of
+    // different symbol multisets are unlikely to collide
+    static uint64_t symbol_hash(const uint64_t c) {
+        uint64_t x = c + 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    // checks whether the histogram belongs to the input - the text length
+    // must match and the hashes of all symbol occurrences must sum up to
+    // the same checksum (modulo 2^64), which every worker computes for its
+    // local input in one read pass, the check cannot tell permutations of
+    // the text apart, which have the same histogram
+    bool matches(
+        MPIContext& ctx,
+        const FilePartitionReader<sym_t>& input,
+        const size_t rdbufsize) const {
+
+        if(this->text_length() != input.total_size()) return false;
+
+        uint64_t local_sum = 0;
+#pragma omp parallel reduction(+ : local_sum)
+        {
+            input.process_local_omp([&](const size_t, sym_t c){
+                local_sum += symbol_hash(uint64_t(c));
+            }, rdbufsize);
+        }
+
+        uint64_t sum = 0;
+        ctx.all_reduce(&local_sum, &sum, 1);
+
+        uint64_t hist_sum = 0;
+        for(const auto& e : this->m_entries) {
+            hist_sum += symbol_hash(uint64_t(e.first)) * uint64_t(e.second);
+        }
+        return sum == hist_sum;
+    }
+
+    // the number of symbols every thread sorts at a time for wide alphabets
+    static constexpr size_t SORT_BLOCK_SIZE = 1ULL << 22;
+
+    // sorts the n symbols of src by LSD radix sort using keys and tmp,
+    // skipping the digits that are equal for all symbols, and returns the
+    // buffer holding the result, which is src if there is nothing to sort
+    static const sym_t* radix_sort(
+        const sym_t* src, sym_t* keys, sym_t* tmp, const size_t n) {
+
+        constexpr size_t RADIX = 256;
+
+        if(n == 0) return src;
+
+        size_t count[RADIX];
+        for(size_t d = 0; d < sizeof(sym_t); d++) {
+            const size_t shift = 8 * d;
+            auto digit = [&](const sym_t x) {
+                return size_t((uint64_t(x) >> shift) & (RADIX - 1));
             };
 
-#pragma omp parallel
-            {
-                auto& hist = sharded_hists[omp_get_thread_num()];
-                input.process_local_omp([&] (const size_t, sym_t c) {
-                    map_inserter(hist, c);
-                }, rdbufsize);
+            std::fill(count, count + RADIX, 0);
+            for(size_t i = 0; i < n; i++) {
+                ++count[digit(src[i])];
             }
 
-            // Accumulate the histograms
-            auto& local_hist = sharded_hists[0];
-            for(size_t shard = 1; shard < sharded_hists.size(); shard++) {
-                const auto& shard_hist = sharded_hists[shard];
-                for(const auto& pair : shard_hist) {
-                    map_inserter(local_hist, pair.first, pair.second);
-                }
+            if(count[digit(src[0])] == n) continue; // nothing to do
+
+            size_t offs = 0;
+            for(size_t j = 0; j < RADIX; j++) {
+                const size_t c = count[j];
+                count[j] = offs;
+                offs += c;
+            }
+
+            for(size_t i = 0; i < n; i++) {
+                keys[count[digit(src[i])]++] = src[i];
+            }
+            src = keys;
+            std::swap(keys, tmp);
+        }
+        return src;
+    }
+
+    // merges two sorted run-length histograms
+    static std::vector<entry_t> merge_runs(
+        const std::vector<entry_t>& a, const std::vector<entry_t>& b) {
+
+        std::vector<entry_t> m;
+        m.reserve(a.size() + b.size());
+
+        auto i = a.begin();
+        auto j = b.begin();
+        while(i != a.end() && j != b.end()) {
+            if(i->first < j->first) {
+                m.push_back(*i++);
+            } else if(j->first < i->first) {
+                m.push_back(*j++);
+            } else {
+                m.emplace_back(i->first, i->second + j->second);
+                ++i;
+                ++j;
             }
+        }
+        m.insert(m.end(), i, a.end());
+        m.insert(m.end(), j, b.end());
+        return m;
+    }
+
+    // computes the sorted local histogram for wide alphabets: the local
+    // text is processed in blocks, of which every thread radix sorts a part
+    // of at most SORT_BLOCK_SIZE symbols and counts the runs of equal
+    // symbols, so the sort buffers do not depend on the text length, but
+    // on the read buffer size at most
+    // the threads' runs are merged pairwise, and the runs of the blocks
+    // like a binary counter, so every run is merged O(log #blocks) times
+    static std::vector<entry_t> compute_local_runs(
+        const FilePartitionReader<sym_t>& input,
+        const size_t rdbufsize) {
 
-            // distribute using tree-like communication
+        const size_t max_threads = omp_get_max_threads();
+        const size_t block_size = std::max(std::min({
+            input.local_num(), rdbufsize, max_threads * SORT_BLOCK_SIZE }), size_t(1));
+
+        std::vector<sym_t> keys(block_size), tmp(block_size);
+        std::vector<std::vector<entry_t>> runs(max_threads);
+        std::vector<size_t> num_runs(max_threads, 0);
+
+        // the merged runs of 2^k blocks for the set bits k of the number
+        // of blocks processed so far, in decreasing order of k
+        std::vector<std::pair<std::vector<entry_t>, size_t>> merged;
+
+        input.process_local_blocks([&](const sym_t* block, const size_t n){
+#pragma omp parallel
             {
-                std::vector<sym_t> buf_syms;
-                std::vector<idx_t> buf_occs;
-
-                const size_t rank = ctx.rank();
-                const size_t p = ctx.num_workers();
-                const bool last = (rank == p-1);
-                const size_t logp = tlx::integer_log2_ceil(p);
-
-                // bottom-up
-                for(size_t lv = 0; lv < logp; lv++) {
-                    const size_t d = 1ULL << lv;
-                    const size_t mask = d - 1;
-
-                    // on the bottom level, every worker is active
-                    // the last worker is always active
-                    // otherwise, activity is determined by applying the level mask
-                    if((lv == 0) || last || ((rank & mask) == mask)) {
-                        // active - send or receive based on level rank
-                        const size_t lv_rank = rank >> lv;
-                        if(lv_rank & 1ULL) {
-                            // odd - receive from left neighbor
-                            const size_t ln = (lv_rank - 1) * d + mask;
-
-                            auto r = ctx.template probe<sym_t>(ln);
-                            ctx.recv(buf_syms, r.size, ln);
-                            ctx.recv(buf_occs, r.size, ln);
-
-                            // accumulate
-                            for(size_t i = 0; i < r.size; i++) {
-                                const auto c = buf_syms[i];
-                                const auto occ = buf_occs[i];
-
-                                auto it = local_hist.find(c);
-                                if(it != local_hist.end()) {
-                                    it->second += occ;
-                                } else {
-                                    local_hist.emplace(c, occ);
-                                }
-                            }
-                        } else {
-                            // even - send to right neighbor
-                            const size_t rn = std::min(rank + d, p-1);
-                            if(rn != rank) {
-                                extract_map(local_hist, buf_syms, buf_occs);
-                                ctx.send(buf_syms, rn);
-                                ctx.send(buf_occs, rn);
-                            } else {
-                                // would send to self - skip!
-                            }
-                        }
-                    } else {
-                        // idle - do nothing
-                    }
+                const size_t t = omp_get_thread_num();
+                const size_t num_threads = omp_get_num_threads();
+                const size_t begin = (t * n) / num_threads;
+                const size_t end = ((t + 1) * n) / num_threads;
+
+                const sym_t* sorted = radix_sort(
+                    block + begin, keys.data() + begin, tmp.data() + begin, end - begin);
+
+                size_t r = 0;
+                for(size_t i = 0; i < end - begin; i++) {
+                    if(i == 0 || sorted[i] != sorted[i-1]) ++r;
                 }
+                num_runs[t] = r;
+
+#pragma omp barrier
 
-                // top-down
-                for(size_t _lv = logp; _lv > 0; _lv--) {
-                    const size_t lv = _lv - 1;
-                    const size_t d = 1ULL << lv;
-                    const size_t mask = d - 1;
-
-                    // on the bottom level, every worker is active
-                    // the last worker is always active
-                    // otherwise, activity is determined by applying the level mask
-                    if((lv == 0) || last || ((rank & mask) == mask)) {
-                        // active - send or receive based on level rank
-                        const size_t lv_rank = rank >> lv;
-                        if(lv_rank & 1ULL) {
-                            // odd - send to left neighbor
-                            const size_t ln = (lv_rank - 1) * d + mask;
-
-                            extract_map(local_hist, buf_syms, buf_occs);
-                            ctx.send(buf_syms, ln);
-                            ctx.send(buf_occs, ln);
-                        } else {
-                            // even - receive from right neighbor
-                            const size_t rn = std::min(rank + d, p-1);
-                            if(rn != rank) {
-                                auto r = ctx.template probe<sym_t>(rn);
-                                ctx.recv(buf_syms, r.size, rn);
-                                ctx.recv(buf_occs, r.size, rn);
-
-                                // update
-                                local_hist.clear();
-                                for(size_t i = 0; i < r.size; i++) {
-                                    local_hist.emplace(buf_syms[i], buf_occs[i]);
-                                }
-                            } else {
-                                // would send to self - skip!
-                            }
-                        }
+                // allocate runs (not in parallel, to keep allocation counting intact)
+#pragma omp single
+                for(size_t u = 0; u < num_threads; u++) {
+                    runs[u].clear();
+                    runs[u].reserve(num_runs[u]);
+                }
+
+                auto& local_runs = runs[t];
+                for(size_t i = 0; i < end - begin; i++) {
+                    if(i == 0 || sorted[i] != sorted[i-1]) {
+                        local_runs.emplace_back(sorted[i], idx_t(1));
                     } else {
-                        // idle - do nothing
+                        ++local_runs.back().second;
                     }
                 }
             }
 
-            // compute entries
-            for(const auto& it : local_hist) {
-                this->m_entries.emplace_back(it.first, it.second);
+            // merge the threads' runs
+            for(size_t d = 1; d < max_threads; d *= 2) {
+                for(size_t t = 0; t + d < max_threads; t += 2 * d) {
+                    runs[t] = merge_runs(runs[t], runs[t + d]);
+                    runs[t + d].clear();
+                    runs[t + d].shrink_to_fit();
+                }
+            }
+
+            // merge with the runs of as many previous blocks
+            std::vector<entry_t> block_runs = std::move(runs[0]);
+            size_t num_blocks = 1;
+            while(!merged.empty() && merged.back().second == num_blocks) {
+                block_runs = merge_runs(merged.back().first, block_runs);
+                num_blocks *= 2;
+                merged.pop_back();
+            }
+            merged.emplace_back(std::move(block_runs), num_blocks);
+        }, block_size);
+
+        keys.clear();
+        keys.shrink_to_fit();
+        tmp.clear();
+        tmp.shrink_to_fit();
+
+        // merge the runs of the remaining block counts, smallest first
+        std::vector<entry_t> local_runs;
+        while(!merged.empty()) {
+            local_runs = merge_runs(merged.back().first, local_runs);
+            merged.pop_back();
+        }
+        return local_runs;
+    }
+
+    // dense implementation for alphabets of up to 16 bits
+    inline void compute_dense_histogram(
+        MPIContext& ctx,
+        const FilePartitionReader<sym_t>& input,
+        const size_t rdbufsize) {
+
+        constexpr size_t SIGMA_MAX = 1ULL << (8 * sizeof(sym_t));
+
+        helper_array sharded_hists(omp_get_max_threads(), SIGMA_MAX);
+
+#pragma omp parallel
+        {
+            const auto shard = omp_get_thread_num();
+            auto&& hist = sharded_hists[shard];
+
+            input.process_local_omp([&](const size_t, sym_t c){
+                ++hist[c];
+            }, rdbufsize);
+        }
+
+        // Accumulate the histograms
+        auto&& local_hist = sharded_hists[0];
+#pragma omp parallel for
+        for (uint64_t j = 0; j < SIGMA_MAX; ++j) {
+            for (uint64_t shard = 1; shard < sharded_hists.levels(); ++shard) {
+                local_hist[j] += sharded_hists[shard][j];
+            }
+        }
+
+        // distribute
+        std::vector<size_t> hist(SIGMA_MAX);
+        ctx.all_reduce(local_hist.data(), hist.data(), SIGMA_MAX);
+
+        // extract nonzero entries
+        for(size_t c = 0; c < SIGMA_MAX; c++) {
+            if(hist[c] > 0) {
+                this->m_entries.emplace_back(sym_t(c), hist[c]);
             }
         }
+    }
 
-        // sort entries
-        std::sort(this->m_entries.begin(), this->m_entries.end(),
-            [](const typename HistogramBase<sym_t, idx_t>::entry_t& a,
-               const typename HistogramBase<sym_t, idx_t>::entry_t& b){
-                return a.first < b.first;
-            });
+    // base implementation for wide alphabets
+    inline void compute_histogram(
+        MPIContext& ctx,
+        const FilePartitionReader<sym_t>& input,
+        const size_t rdbufsize) {
+
+        auto runs = compute_local_runs(input, rdbufsize);
+
+        // reduce the sorted runs to the root using a binomial tree,
+        // merging pairwise on every level
+        {
+            std::vector<sym_t> buf_syms;
+            std::vector<idx_t> buf_occs;
+
+            const size_t rank = ctx.rank();
+            const size_t p = ctx.num_workers();
+
+            for(size_t d = 1; d < p; d *= 2) {
+                if(rank % (2 * d) == d) {
+                    // send to left neighbor and leave
+                    const size_t ln = rank - d;
+
+                    buf_syms.resize(runs.size());
+                    buf_occs.resize(runs.size());
+                    for(size_t i = 0; i < runs.size(); i++) {
+                        buf_syms[i] = runs[i].first;
+                        buf_occs[i] = runs[i].second;
+                    }
+
+                    ctx.send(buf_syms, ln);
+                    ctx.send(buf_occs, ln);
+                    break;
+                } else if(rank + d < p) {
+                    // receive from right neighbor and merge
+                    const size_t rn = rank + d;
+
+                    auto r = ctx.template probe<sym_t>(rn);
+                    ctx.recv(buf_syms, r.size, rn);
+                    ctx.recv(buf_occs, r.size, rn);
+
+                    std::vector<entry_t> recv_runs;
+                    recv_runs.reserve(r.size);
+                    for(size_t i = 0; i < r.size; i++) {
+                        recv_runs.emplace_back(buf_syms[i], buf_occs[i]);
+                    }
+
+                    runs = merge_runs(runs, recv_runs);
+                }
+            }
+
+            // broadcast the sorted entries
+            if(rank == 0) {
+                buf_syms.resize(runs.size());
+                buf_occs.resize(runs.size());
+                for(size_t i = 0; i < runs.size(); i++) {
+                    buf_syms[i] = runs[i].first;
+                    buf_occs[i] = runs[i].second;
+                }
+            }
+
+            ctx.bcast(buf_syms, 0);
+            ctx.bcast(buf_occs, 0);
+
+            // compute entries, which are sorted by symbol
+            this->m_entries.clear();
+            this->m_entries.reserve(buf_syms.size());
+            for(size_t i = 0; i < buf_syms.size(); i++) {
+                this->m_entries.emplace_back(buf_syms[i], buf_occs[i]);
+            }
+        }
 
         /*
         if(ctx.rank() == 0) {
@@ -200,37 +452,15 @@ inline void Histogram<uint8_t>::compute_histogram(
     const FilePartitionReader<uint8_t>& input,
     const size_t rdbufsize) {
 
-    constexpr size_t SIGMA_MAX = 256ULL;
-
-    helper_array sharded_hists(omp_get_max_threads(), SIGMA_MAX);
-
-#pragma omp parallel
-{
-    const auto shard = omp_get_thread_num();
-    auto&& hist = sharded_hists[shard];
-
-    input.process_local_omp([&](const size_t, uint8_t c){
-        ++hist[c];
-    }, rdbufsize);
+    compute_dense_histogram(ctx, input, rdbufsize);
 }
 
-    // Accumulate the histograms
-    auto&& local_hist = sharded_hists[0];
-#pragma omp parallel for schedule(nonmonotonic : dynamic, 1)
-    for (uint64_t j = 0; j < SIGMA_MAX; ++j) {
-        for (uint64_t shard = 1; shard < sharded_hists.levels(); ++shard) {
-            local_hist[j] += sharded_hists[shard][j];
-        }
-    }
-
-    // distribute
-    size_t hist[SIGMA_MAX] = {0};
-    ctx.all_reduce(local_hist.data(), hist, SIGMA_MAX);
+// specialization for 16-bit alphabets
+template<>
+inline void Histogram<uint16_t>::compute_histogram(
+    MPIContext& ctx,
+    const FilePartitionReader<uint16_t>& input,
+    const size_t rdbufsize) {
 
-    // extract nonzero entries
-    for(size_t c = 0; c < SIGMA_MAX; c++) {
-        if(hist[c] > 0) {
-            m_entries.emplace_back((uint8_t)c, hist[c]);
-        }
-    }
+    compute_dense_histogram(ctx, input, rdbufsize);
 }
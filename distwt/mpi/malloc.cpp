@@ -1,6 +1,8 @@
 #include <distwt/mpi/malloc.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cstring>
 
 void (*malloc_callback::on_alloc)(size_t) = NULL;
@@ -8,6 +10,10 @@ void (*malloc_callback::on_free)(size_t) = NULL;
 
 constexpr size_t MEMBLOCK_MAGIC = 0xFEDCBA9876543210;
 
+// aligned blocks are preceded by padding, which ends with the offset of the
+// block from the allocated memory followed by the header
+constexpr size_t ALIGNED_MEMBLOCK_MAGIC = 0xFEDCBA9876543211;
+
 bool callback_guard = false;
 
 struct block_header_t {
@@ -19,6 +25,15 @@ inline bool is_managed(block_header_t* block) {
     return (block->magic == MEMBLOCK_MAGIC);
 }
 
+inline bool is_managed_aligned(block_header_t* block) {
+    return (block->magic == ALIGNED_MEMBLOCK_MAGIC);
+}
+
+inline void* aligned_base(block_header_t* block) {
+    const size_t offs = *((size_t*)block - 1);
+    return (char*)block + sizeof(block_header_t) - offs;
+}
+
 inline void on_alloc(size_t size) {
     if(malloc_callback::on_alloc && !callback_guard) {
         callback_guard = true;
@@ -59,6 +74,9 @@ extern "C" void free(void* ptr) {
     if(is_managed(block)) {
         on_free(block->size);
         __libc_free(block);
+    } else if(is_managed_aligned(block)) {
+        on_free(block->size);
+        __libc_free(aligned_base(block));
     } else {
         __libc_free(ptr);
     }
@@ -84,6 +102,14 @@ extern "C" void* realloc(void* ptr, size_t size) {
             on_alloc(size);
 
             return (char*)new_ptr + sizeof(block_header_t);
+        } else if(is_managed_aligned(block)) {
+            // the alignment need not be preserved
+            void* new_ptr = malloc(size);
+            if(new_ptr) {
+                memcpy(new_ptr, ptr, std::min(size, block->size));
+                free(ptr);
+            }
+            return new_ptr;
         } else {
             return __libc_realloc(ptr, size);
         }
@@ -98,3 +124,46 @@ extern "C" void* calloc(size_t num, size_t size) {
     memset(ptr, 0, size);
     return ptr;
 }
+
+// the aligned allocation functions must be covered as well, otherwise free
+// would have to guess whether a block is managed from the memory preceding it
+inline void* aligned_malloc(size_t alignment, size_t size) {
+    if(alignment <= sizeof(block_header_t)) {
+        // blocks returned by malloc are sufficiently aligned
+        return malloc(size);
+    }
+
+    if(!size) {
+        return NULL;
+    }
+
+    // alignment is a power of two greater than the header,
+    // so the padding can hold the header and the offset
+    void *base = __libc_memalign(alignment, size + alignment);
+    if(!base) return base; // malloc failed
+
+    auto block = (block_header_t*)((char*)base + alignment - sizeof(block_header_t));
+    block->magic = ALIGNED_MEMBLOCK_MAGIC;
+    block->size = size;
+    *((size_t*)block - 1) = alignment;
+
+    on_alloc(size);
+
+    return (char*)base + alignment;
+}
+
+extern "C" void* memalign(size_t alignment, size_t size) {
+    return aligned_malloc(alignment, size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size) {
+    return aligned_malloc(alignment, size);
+}
+
+extern "C" int posix_memalign(void** memptr, size_t alignment, size_t size) {
+    void* ptr = aligned_malloc(alignment, size);
+    if(!ptr && size) return ENOMEM;
+
+    *memptr = ptr;
+    return 0;
+}
@@ -14,4 +14,5 @@ public:
 
 extern "C" void* __libc_malloc(size_t);
 extern "C" void  __libc_free(void*);
-extern "C" void* __libc_realloc(void*, size_t);
\ No newline at end of file
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void* __libc_memalign(size_t, size_t);
\ No newline at end of file
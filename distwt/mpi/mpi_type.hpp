@@ -5,6 +5,10 @@
 
 template<typename T> struct mpi_type;
 
+template<> struct mpi_type<int> {
+    static constexpr MPI_Datatype id() { return MPI_INT; }
+};
+
 template<> struct mpi_type<uint8_t> {
     static constexpr MPI_Datatype id() { return MPI_BYTE; }
 };
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <tlx/math/integer_log2.hpp>
+
+#include <distwt/mpi/bit_vector.hpp>
+
+// the non-empty nodes of a local wavelet tree
+// the bits of a level's nodes are concatenated in node order in one bit
+// vector per level, which the level's directory maps to the node ids, so the
+// memory depends on the amount of bits and of non-empty nodes, but not on the
+// amount of nodes of the tree
+class NodeDirectory {
+public:
+    struct Node {
+        size_t node_id;
+        size_t offs; // offset in the level bit vector
+        size_t size;
+    };
+
+private:
+    std::vector<std::vector<Node>> m_nodes; // ascending node ids per level
+    std::vector<bv_t> m_bits;
+
+public:
+    inline NodeDirectory() {
+    }
+
+    inline NodeDirectory(const size_t height) : m_nodes(height), m_bits(height) {
+    }
+
+    inline size_t height() const { return m_nodes.size(); }
+
+    // the amount of non-empty nodes
+    inline size_t num_nodes() const {
+        size_t num = 0;
+        for(const auto& nodes : m_nodes) {
+            num += nodes.size();
+        }
+        return num;
+    }
+
+    inline std::vector<Node>& nodes(const size_t level) { return m_nodes[level]; }
+    inline const std::vector<Node>& nodes(const size_t level) const { return m_nodes[level]; }
+
+    inline bv_t& bits(const size_t level) { return m_bits[level]; }
+    inline const bv_t& bits(const size_t level) const { return m_bits[level]; }
+
+    // the node with the given id, nullptr if it is empty
+    inline const Node* find(const size_t node_id) const {
+        const auto& nodes = m_nodes[tlx::integer_log2_floor(node_id)];
+        const auto it = std::lower_bound(nodes.begin(), nodes.end(), node_id,
+            [](const Node& node, const size_t id){ return node.node_id < id; });
+        return (it != nodes.end() && it->node_id == node_id) ? &*it : nullptr;
+    }
+
+    // releases the nodes of a level
+    inline void clear(const size_t level) {
+        m_nodes[level].clear();
+        m_nodes[level].shrink_to_fit();
+        m_bits[level].clear();
+        m_bits[level].shrink_to_fit();
+    }
+};
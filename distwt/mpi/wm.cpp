@@ -0,0 +1,26 @@
+#include <distwt/mpi/wm.hpp>
+#include <distwt/common/binary_io.hpp>
+
+void WaveletMatrix::count_zeros(MPIContext& ctx) {
+    // count local zeros, bits beyond the size are zero
+    std::vector<size_t> local_zeros(height());
+    for(size_t level = 0; level < height(); level++) {
+        const auto& bv = m_bits[level];
+
+        const size_t ones = bit_extract::popcount_words(bv.data(), bv.num_words());
+        local_zeros[level] = bv.size() - ones;
+    }
+
+    // reduce
+    m_zeros.resize(height());
+    ctx.all_reduce(local_zeros.data(), m_zeros.data(), height());
+}
+
+void WaveletMatrix::save_zeros(const std::string& output) const {
+    binary::FileWriter w(output + "." + zeros_extension());
+
+    w.write<size_t>(m_zeros.size()); // num levels
+    for(const size_t z : m_zeros) {
+        w.write<size_t>(z);
+    }
+}
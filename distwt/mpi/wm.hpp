@@ -0,0 +1,34 @@
+#pragma once
+
+#include <distwt/mpi/wt_levelwise.hpp>
+#include <distwt/mpi/context.hpp>
+
+// wavelet matrix - every level holds the nodes of the corresponding
+// wavelet tree level in bit-reversed order, and the global number of zeros
+// of every level is known
+class WaveletMatrix : public WaveletTreeLevelwise {
+private:
+    std::vector<size_t> m_zeros;
+
+    void count_zeros(MPIContext& ctx);
+
+public:
+    template<typename sym_t>
+    inline WaveletMatrix(
+        MPIContext& ctx,
+        const Histogram<sym_t>& hist,
+        ctor_t construction_algorithm)
+        : WaveletTreeLevelwise(hist, construction_algorithm) {
+
+        count_zeros(ctx);
+    }
+
+    static inline std::string zeros_extension() {
+        return "zeros";
+    }
+
+    inline const std::vector<size_t>& zeros() const { return m_zeros; }
+
+    // saves the number of zeros of every level
+    void save_zeros(const std::string& output) const;
+};
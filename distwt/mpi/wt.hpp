@@ -28,5 +28,15 @@ public:
         construction_algorithm(m_bits, *this);
     }
 
+    template<typename sym_t>
+    inline WaveletTree(
+        const Histogram<sym_t>& hist,
+        const size_t height,
+        ctor_t construction_algorithm)
+        : WaveletTreeBase(hist, height) {
+
+        construction_algorithm(m_bits, *this);
+    }
+
     inline const bits_t& raw_bits() const noexcept { return m_bits; };
 };
@@ -1,6 +1,6 @@
-#include <distwt/common/bv64.hpp>
 #include <distwt/mpi/wt_levelwise.hpp>
 
+#include <algorithm>
 #include <iomanip>
 #include <mpi.h>
 
@@ -29,29 +29,110 @@ void WaveletTreeLevelwise::save(
             MPI_INFO_NULL,
             &f);
 
-        // write
+        // write whole words, the bit vector layout matches the file format
         MPI_Status status;
 
-        bv64_t bitbuf;
-        size_t x = 0;
+        const auto& bv = m_bits[level];
+        MPI_File_write(f, bv.data(), bv.num_words(), MPI_LONG_LONG, &status);
+
+        // close file
+        MPI_File_close(&f);
+    }
+}
+
+void WaveletTreeLevelwise::save_single_file(
+    MPIContext& ctx,
+    const std::string& output) {
+
+    const size_t rank = ctx.rank();
+    const size_t num_workers = ctx.num_workers();
+
+    // gather the sizes of the level slices of all workers
+    std::vector<uint64_t> local_sizes(height());
+    for(size_t level = 0; level < height(); level++) {
+        local_sizes[level] = m_bits[level].size();
+    }
+    const auto sizes = ctx.all_gather(local_sizes);
+
+    // hints for collective buffering
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "romio_cb_write", "enable");
+    MPI_Info_set(info, "collective_buffering", "true");
+
+    // save WT levels
+    for(size_t level = 0; level < height(); level++) {
+        // global bit offsets of the workers' slices
+        std::vector<size_t> offs(num_workers + 1, 0);
+        for(size_t r = 0; r < num_workers; r++) {
+            offs[r+1] = offs[r] + sizes[r * height() + level];
+        }
+
+        // the worker whose slice contains the first bit of a word writes that word
+        auto owner = [&](const size_t word) {
+            return size_t(std::upper_bound(offs.begin(), offs.end(), word * 64) - offs.begin() - 1);
+        };
 
         const auto& bv = m_bits[level];
-        for(size_t i = 0; i < bv.size(); i++) {
-            bitbuf[63ULL - (x++)] = bv[i];
-            if(x >= 64ULL) {
-                uint64_t ull = bitbuf.to_ullong();
-                MPI_File_write(f, &ull, 1, MPI_LONG_LONG, &status);
+        const size_t g = offs[rank];
+        const size_t n = bv.size();
 
-                x = 0;
-            }
+        const size_t first_word = bv_t::num_words(g);
+        const size_t end_word = bv_t::num_words(g + n);
+
+        // bits in front of the first word are sent to the owner of their word
+        const size_t head = std::min(first_word * 64, g + n) - g;
+
+        uint64_t head_word = 0;
+        MPI_Request req = MPI_REQUEST_NULL;
+        if(head > 0) {
+            copy_bits(&head_word, g % 64, bv.data(), 0, head);
+            req = ctx.isend(&head_word, 1, owner(g / 64), int(level));
         }
 
-        if(x > 0) {
-            uint64_t ull = bitbuf.to_ullong();
-            MPI_File_write(f, &ull, 1, MPI_LONG_LONG, &status);
+        // align the remaining bits to the global word grid
+        std::vector<uint64_t> buf(end_word > first_word ? end_word - first_word : 0);
+        if(!buf.empty()) {
+            copy_bits(buf.data(), 0, bv.data(), head, n - head);
+
+            // merge the heads of the following workers sharing the last word
+            if((g + n) % 64) {
+                for(size_t r = rank + 1; r < num_workers && offs[r] < end_word * 64; r++) {
+                    if(offs[r+1] > offs[r]) {
+                        uint64_t w;
+                        ctx.recv(&w, 1, r, int(level));
+                        buf.back() |= w;
+                    }
+                }
+            }
         }
 
+        MPI_Wait(&req, MPI_STATUS_IGNORE);
+
+        // open file
+        const std::string filename = output + "." + WaveletTreeBase::level_extension(level);
+
+        MPI_File f;
+        MPI_File_open(
+            ctx.comm(),
+            filename.c_str(),
+            MPI_MODE_WRONLY | MPI_MODE_CREATE,
+            info,
+            &f);
+
+        MPI_File_set_size(f, MPI_Offset(bv_t::num_words(offs.back()) * sizeof(uint64_t)));
+
+        // write the local slice with a single collective call
+        MPI_Status status;
+        MPI_File_write_at_all(
+            f,
+            MPI_Offset(first_word * sizeof(uint64_t)),
+            buf.data(), buf.size(), MPI_LONG_LONG,
+            &status);
+
         // close file
         MPI_File_close(&f);
     }
+
+    MPI_Info_free(&info);
 }
@@ -12,5 +12,17 @@ public:
         : WaveletTree(hist, construction_algorithm) {
     }
 
+    template<typename sym_t>
+    inline WaveletTreeLevelwise(
+        const Histogram<sym_t>& hist,
+        const size_t height,
+        ctor_t construction_algorithm)
+        : WaveletTree(hist, height, construction_algorithm) {
+    }
+
+    // saves one file per worker and level
     void save(const MPIContext& ctx, const std::string& output);
+
+    // saves one file per level, written collectively by all workers
+    void save_single_file(MPIContext& ctx, const std::string& output);
 };
\ No newline at end of file
@@ -1,22 +1,33 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 
+#include <tlx/math/div_ceil.hpp>
+
 #include <distwt/mpi/wt.hpp>
 #include <distwt/mpi/wt_levelwise.hpp>
-//#include <distwt/mpi/wm.hpp>
+#include <distwt/mpi/wm.hpp>
 
 #include <distwt/mpi/context.hpp>
 #include <distwt/mpi/file_partition_reader.hpp>
+#include <distwt/mpi/node_directory.hpp>
 #include <distwt/mpi/types.hpp>
 
 #include <distwt/common/bitrev.hpp>
-#include <distwt/mpi/uint64_pack_bv64.hpp>
-
-#include <src/omp_write_bits.hpp>
+#include <distwt/common/huffman.hpp>
+#include <distwt/mpi/bv_pack.hpp>
 
 class WaveletTreeLevelwise; // fwd
 class WaveletTreeNodebased : public WaveletTree {
+private:
+    // the maximum number of levels whose merge exchange may be in progress
+    static constexpr size_t MERGE_LEVELS_IN_FLIGHT = 2;
+
+    // whether only the non-empty nodes are stored, in m_nodes
+    bool m_sparse = false;
+    NodeDirectory m_nodes;
+
 public:
     template<typename sym_t>
     inline WaveletTreeNodebased(
@@ -25,6 +36,56 @@ public:
         : WaveletTree(hist, construction_algorithm) {
     }
 
+    template<typename sym_t>
+    inline WaveletTreeNodebased(
+        const Histogram<sym_t>& hist,
+        const size_t height,
+        ctor_t construction_algorithm)
+        : WaveletTree(hist, height, construction_algorithm) {
+    }
+
+    // a tree of the given non-empty nodes, which supports the plain merge
+    template<typename sym_t>
+    inline WaveletTreeNodebased(
+        const Histogram<sym_t>& hist,
+        NodeDirectory&& nodes)
+        : WaveletTree(hist), m_sparse(true), m_nodes(std::move(nodes)) {
+    }
+
+    // counts the local occurrences of every symbol from the leaf level,
+    // where the zeros and ones of a node belong to its two symbols
+    std::vector<uint64_t> leaf_counts() const {
+        const size_t height = this->height();
+        if(height == 0) return std::vector<uint64_t>(1, 0);
+
+        const size_t num_leaves = 1ULL << (height - 1);
+        std::vector<uint64_t> counts(2 * num_leaves);
+
+        if(m_sparse) {
+            const uint64_t* words = m_nodes.bits(height - 1).data();
+            const auto& leaves = m_nodes.nodes(height - 1);
+
+#pragma omp parallel for schedule(nonmonotonic : dynamic, 64)
+            for(size_t i = 0; i < leaves.size(); i++) {
+                const auto& node = leaves[i];
+                const size_t ones = count_ones(words, node.offs, node.size);
+                counts[2 * (node.node_id - num_leaves)] = node.size - ones;
+                counts[2 * (node.node_id - num_leaves) + 1] = ones;
+            }
+            return counts;
+        }
+
+#pragma omp parallel for schedule(nonmonotonic : dynamic, 64)
+        for(size_t i = 0; i < num_leaves; i++) {
+            const auto& bv = m_bits[num_leaves + i - 1];
+
+            const uint64_t ones = bit_extract::popcount_words(bv.data(), bv.num_words());
+            counts[2 * i] = bv.size() - ones;
+            counts[2 * i + 1] = ones;
+        }
+        return counts;
+    }
+
     template<typename sym_t>
     WaveletTreeLevelwise merge(
         MPIContext& ctx,
@@ -34,7 +95,59 @@ public:
 
         return WaveletTreeLevelwise(hist, // TODO: avoid recomputations!
             [&](WaveletTree::bits_t& bits, const WaveletTreeBase& wt){
-                merge_impl(ctx, bits, wt, input, hist, discard, false);
+                merge_impl(ctx, bits, wt, input, hist,
+                    m_sparse ? std::vector<idx_t>() : WaveletTreeBase::node_sizes(hist),
+                    discard, false);
+            });
+    }
+
+    // merges the node bits into the first levels of the given
+    // level bit vectors, e.g., the top levels of a larger tree
+    template<typename sym_t>
+    void merge_levels(
+        MPIContext& ctx,
+        WaveletTree::bits_t& bits,
+        const FilePartitionReader<sym_t>& input,
+        const Histogram<sym_t>& hist,
+        bool discard) {
+
+        assert(!m_sparse);
+        merge_impl(ctx, bits, *this, input, hist,
+            WaveletTreeBase::node_sizes(hist), discard, false);
+    }
+
+    // merges the node bits of a Huffman-shaped tree into its levels,
+    // which become shorter the deeper they are
+    template<typename sym_t>
+    WaveletTreeLevelwise merge_huffman(
+        MPIContext& ctx,
+        const FilePartitionReader<sym_t>& input,
+        const Histogram<sym_t>& hist,
+        const HuffmanCode& code,
+        bool discard) {
+
+        assert(!m_sparse);
+        return WaveletTreeLevelwise(hist, code.height(),
+            [&](WaveletTree::bits_t& bits, const WaveletTreeBase& wt){
+                merge_impl(ctx, bits, wt, input, hist,
+                    code.node_sizes(hist), discard, false);
+            });
+    }
+
+    // merges the node bits into the levels of a wavelet matrix,
+    // which are the tree levels with their nodes in bit-reversed order
+    template<typename sym_t>
+    WaveletMatrix merge_matrix(
+        MPIContext& ctx,
+        const FilePartitionReader<sym_t>& input,
+        const Histogram<sym_t>& hist,
+        bool discard) {
+
+        assert(!m_sparse);
+        return WaveletMatrix(ctx, hist,
+            [&](WaveletTree::bits_t& bits, const WaveletTreeBase& wt){
+                merge_impl(ctx, bits, wt, input, hist,
+                    WaveletTreeBase::node_sizes(hist), discard, true);
             });
     }
 
@@ -46,25 +159,59 @@ private:
         const target_t& target,
         const FilePartitionReader<sym_t>& input,
         const Histogram<sym_t>& hist,
+        const std::vector<idx_t>& node_sizes,
         bool discard,
         bool bit_reversal) {
 
-        auto node_sizes = WaveletTreeBase::node_sizes(hist);
+        assert(!m_sparse || !bit_reversal);
 
         bits.resize(this->height());
-        bits[0] = m_bits[0]; // simply copy root
+        if(this->height() == 0) return; // a tree without levels
+
+        bits[0] = m_sparse ? m_nodes.bits(0) : m_bits[0]; // simply copy root
 
         if(discard) {
-            m_bits[0].clear();
-            m_bits[0].shrink_to_fit();
+            if(m_sparse) {
+                m_nodes.clear(0);
+            } else {
+                m_bits[0].clear();
+                m_bits[0].shrink_to_fit();
+            }
         }
 
         // Part 1 - Distribute local offsets for all nodes
         ctx.cout_master() << "Distributing node prefix sums ..." << std::endl;
 
-        const size_t num_nodes = this->num_nodes();
-        std::vector<idx_t> local_node_offs(num_nodes);
-        {
+        std::vector<idx_t> local_node_offs;
+        std::vector<idx_t> sym_offs, sym_c;
+        if(m_sparse) {
+            // the bits of a node on the previous workers are their
+            // occurrences of the node's symbols, so the local symbol counts
+            // are scanned instead of the local node sizes
+            const size_t height = this->height();
+            const size_t num_leaves = 1ULL << (height - 1);
+            const uint64_t* words = m_nodes.bits(height - 1).data();
+
+            sym_offs.resize(this->sigma() + 1, idx_t(0));
+            for(const auto& node : m_nodes.nodes(height - 1)) {
+                const size_t ones = count_ones(words, node.offs, node.size);
+                sym_offs[2 * (node.node_id - num_leaves)] = idx_t(node.size - ones);
+                if(ones > 0) sym_offs[2 * (node.node_id - num_leaves) + 1] = idx_t(ones);
+            }
+            ctx.ex_scan(sym_offs);
+
+            // turn into prefix sums over the symbols
+            idx_t sum = idx_t(0);
+            for(auto& offs : sym_offs) {
+                const idx_t x = offs;
+                offs = sum;
+                sum = sum + x;
+            }
+            sym_c = hist.compute_C();
+        } else {
+            const size_t num_nodes = this->num_nodes();
+            local_node_offs.resize(num_nodes);
+
             // compute prefix sum of local node sizes
 #pragma omp parallel for schedule(nonmonotonic : dynamic, 1)
             for(size_t i = 0; i < num_nodes; i++) {
@@ -77,189 +224,300 @@ private:
         // Part 2 - Distribute bits in a balanced manner
         ctx.cout_master() << "Distributing level bit vectors ..." << std::endl;
         {
-            // prepare send / receive vectors
-            const size_t bits_per_worker = input.size_per_worker();
+            const size_t height = this->height();
+            const size_t num_workers = ctx.num_workers();
+
+            // every level is distributed evenly by itself, levels of a
+            // Huffman-shaped tree are shorter than the text
+            std::vector<size_t> level_bits_per_worker(height);
+            std::vector<size_t> level_local_num(height);
+            for(size_t level = 0; level < height; level++) {
+                size_t level_size = 0;
+                if(level == 0 || m_sparse) {
+                    level_size = input.total_size();
+                } else {
+                    const size_t num_level_nodes = 1ULL << level;
+                    for(size_t i = 0; i < num_level_nodes; i++) {
+                        level_size += node_sizes[num_level_nodes + i - 1];
+                    }
+                }
+
+                const size_t bits_per_worker =
+                    std::max(tlx::div_ceil(level_size, num_workers), size_t(1));
+                const size_t global_offset = ctx.rank() * bits_per_worker;
 
+                level_bits_per_worker[level] = bits_per_worker;
+                level_local_num[level] = (global_offset < level_size)
+                    ? std::min(bits_per_worker, level_size - global_offset)
+                    : 0;
+            }
+
+            // a local node of a level, whose bits start at bit offs of words
+            struct LocalNode {
+                size_t node_id;
+                const uint64_t* words;
+                size_t offs;
+                size_t size;
+                size_t glob_offs; // offset in global level bit vector
+            };
+
+            // an interval of a local node that is sent to a target
+            struct Interval {
+                size_t node_id;
+                const uint64_t* words;
+                size_t local_offs; // offset in words
+                size_t glob_offs;  // offset in global level bit vector
+                size_t num;
+                size_t target;
+                size_t msg_offs;   // offset of message in target's send block
+            };
+
+            // determine which bits from this worker go to other workers
             // note: nothing to do for the root level!
-            for(size_t level = 1; level < this->height(); level++) {
-                ctx.cout_master() << "level " << (level+1) << " ..." << std::endl;
+            std::vector<std::vector<Interval>> level_intervals(height);
+            std::vector<uint64_t> all_send_counts(num_workers * height, 0);
 
-                // do this level by level
+            for(size_t level = 1; level < height; level++) {
                 const size_t num_level_nodes = 1ULL << level;
                 const size_t first_level_node = num_level_nodes;
+                const size_t bits_per_worker = level_bits_per_worker[level];
+
+                // compute global offsets of the level's local nodes
+                std::vector<LocalNode> local_nodes;
+                if(m_sparse) {
+                    // a node's symbols follow the smaller symbols of all workers
+                    const size_t sigma = this->sigma();
+                    const size_t shift = this->height() - level;
+                    const uint64_t* words = m_nodes.bits(level).data();
+
+                    local_nodes.reserve(m_nodes.nodes(level).size());
+                    for(const auto& node : m_nodes.nodes(level)) {
+                        const size_t v = node.node_id - first_level_node;
+                        const size_t a = std::min(v << shift, sigma);
+                        const size_t b = std::min((v + 1) << shift, sigma);
+
+                        local_nodes.push_back({ node.node_id, words, node.offs, node.size,
+                            size_t(sym_c[a]) + size_t(sym_offs[b]) - size_t(sym_offs[a]) });
+                    }
+                } else {
+                    size_t offs = 0;
+                    for(size_t i = 0; i < num_level_nodes; i++) {
+                        const size_t node_id = first_level_node +
+                            (bit_reversal ? bitrev(i, level) : i);
 
-                // allocate message buffers
-                struct MSG_Send_Data {
-                    uint64_t* msg;
-                    size_t size;
-                    size_t target;
-                    int level;
-                };
-
-                // allocate space for Message buffers
-                std::vector<std::vector<MSG_Send_Data>> msg_buf(num_level_nodes);
-                for(size_t i = 0; i < num_level_nodes; i++) {
-                    msg_buf[i].reserve(ctx.num_workers());
+                        const auto& bv = m_bits[node_id-1];
+                        if(bv.size() > 0) {
+                            local_nodes.push_back({ node_id, bv.data(), 0, bv.size(),
+                                offs + local_node_offs[node_id-1] });
+                        }
+                        offs += node_sizes[node_id-1];
+                    }
                 }
 
-                // determine which bits from this worker go to other workers
+                std::vector<std::vector<Interval>> node_intervals(local_nodes.size());
+
                 ctx.enable_alloc_count(false);
 #pragma omp parallel for schedule(nonmonotonic : dynamic, 1)
-                for(size_t i = 0; i < num_level_nodes; i++) {
-                    const size_t node_id = first_level_node +
-                        (bit_reversal ? bitrev(i, level) : i);
-
-                    // compute level node offset
-                    size_t level_node_offs = 0;
-                    for(size_t j = 0; j < i; j++) {
-                        const size_t idx = first_level_node + (bit_reversal ? bitrev(j, level) : j);
-                        level_node_offs += node_sizes[idx-1];
-                    }
-
-                    auto& bv = m_bits[node_id-1];
-                    if(bv.size() > 0) {
-                        const size_t glob_node_offs =
-                            level_node_offs + local_node_offs[node_id-1];
+                for(size_t i = 0; i < local_nodes.size(); i++) {
+                    const auto& node = local_nodes[i];
+                    const size_t node_id = node.node_id;
+                    const size_t glob_node_offs = node.glob_offs;
 
-                        // map range of the local node's bit vector
-                        // in global level's bit vector
-                        size_t p = glob_node_offs;
-                        const size_t q = p + bv.size();
+                    // map range of the local node's bit vector
+                    // in global level's bit vector
+                    size_t p = glob_node_offs;
+                    const size_t q = p + node.size;
 
-                        auto& local_msg_buf = msg_buf[i];
+                    while(p < q) {
+                        // determine target
+                        const size_t target = p / bits_per_worker;
 
-                        while(p < q) {
-                            // determine target
-                            const size_t target = p / bits_per_worker;
+                        // determine next boundary
+                        const size_t x = std::min(
+                            (target+1) * bits_per_worker, q);
 
-                            // determine next boundary
-                            const size_t x = std::min(
-                                (target+1) * bits_per_worker, q);
-
-                            // send interval [p,x) to target
-                            const size_t local_offs = p - glob_node_offs;
-                            const size_t num = x - p;
-
-                            #ifdef DBG_MERGE
-                            ctx.cout() << "Send [" << p << "," << x << ") ("
-                                << num << " bits) of level " << (level+1)
-                                << " (node " << node_id << ")"
-                                << " to #" << target << std::endl;
-                            #endif
+                        #ifdef DBG_MERGE
+                        ctx.cout() << "Send [" << p << "," << x << ") ("
+                            << (x - p) << " bits) of level " << (level+1)
+                            << " (node " << node_id << ")"
+                            << " to #" << target << std::endl;
+                        #endif
 
-                            const size_t size =
-                                bv64_pack_t::required_bufsize(num)+2;
+                        // send interval [p,x) to target
+                        node_intervals[i].push_back({ node_id, node.words,
+                            node.offs + (p - glob_node_offs), p, x - p, target, 0 });
 
-                            uint64_t* msg = new uint64_t[size];
-                            msg[0] = p;
-                            msg[1] = num;
-                            bv64_pack_t::pack(bv, local_offs, msg+2, num);
-                            local_msg_buf.push_back({ msg, size, target, static_cast<int>(level) });
+                        // advance in node
+                        p = x;
+                    }
+                }
+                ctx.enable_alloc_count(true);
 
-                            // advance in node
-                            p = x;
-                        }
+                // lay out the send block of every target,
+                // each message consists of offset, length and the bits packed
+                // for the word grid of the target's level bit vector
+                auto& intervals = level_intervals[level];
+                for(const auto& ivs : node_intervals) {
+                    for(auto iv : ivs) {
+                        uint64_t& count = all_send_counts[iv.target * height + level];
+                        iv.msg_offs = count;
+                        count += bv_pack_t::required_bufsize(
+                            iv.glob_offs - iv.target * bits_per_worker, iv.num) + 2;
+                        intervals.push_back(iv);
                     }
+                }
+            }
 
+            // exchange the block sizes of all levels at once
+            std::vector<uint64_t> all_recv_counts(num_workers * height);
+            ctx.alltoall(all_send_counts.data(), all_recv_counts.data(), height);
+
+            // the exchange of a level that is in flight
+            struct LevelExchange {
+                size_t level;
+                std::vector<int> send_counts, send_displs;
+                std::vector<int> recv_counts, recv_displs;
+                std::vector<uint64_t> send_buf, recv_buf;
+            };
+
+            std::vector<LevelExchange> in_flight;
+            std::vector<MPI_Request> in_flight_reqs;
+
+            // pack a level's messages and start the exchange
+            auto post = [&](const size_t level) {
+                LevelExchange ex;
+                ex.level = level;
+
+                ex.send_counts.resize(num_workers);
+                ex.recv_counts.resize(num_workers);
+                ex.send_displs.resize(num_workers);
+                ex.recv_displs.resize(num_workers);
+
+                // the counts are summed up as 64-bit words and narrowed
+                // for MPI with a check
+                size_t send_size = 0, recv_size = 0;
+                for(size_t i = 0; i < num_workers; i++) {
+                    const size_t send_count = all_send_counts[i * height + level];
+                    const size_t recv_count = all_recv_counts[i * height + level];
+                    ex.send_counts[i] = mpi_count(send_count);
+                    ex.recv_counts[i] = mpi_count(recv_count);
+                    ex.send_displs[i] = mpi_count(send_size);
+                    ex.recv_displs[i] = mpi_count(recv_size);
+                    send_size += send_count;
+                    recv_size += recv_count;
                 }
 
-                ctx.enable_alloc_count(true);
+                ex.send_buf.resize(send_size);
+                ex.recv_buf.resize(recv_size);
 
-                //send the buffers
-                for(const auto& group : msg_buf) {
-                    for(const auto& msg_data : group) {
-                        ctx.isend(msg_data.msg, msg_data.size, msg_data.target, msg_data.level);
-                        ctx.track_alloc(msg_data.size * sizeof(uint64_t));
-                    }
+                const auto& intervals = level_intervals[level];
+                const size_t bits_per_worker = level_bits_per_worker[level];
+#pragma omp parallel for schedule(nonmonotonic : dynamic, 1)
+                for(size_t i = 0; i < intervals.size(); i++) {
+                    const auto& iv = intervals[i];
+                    uint64_t* msg = ex.send_buf.data() + ex.send_displs[iv.target] + iv.msg_offs;
+                    msg[0] = iv.glob_offs;
+                    msg[1] = iv.num;
+                    bv_pack_t::pack(iv.words, iv.local_offs, msg+2,
+                        iv.glob_offs - iv.target * bits_per_worker, iv.num);
                 }
 
-                // discard node bit vector
-                if(discard) {
+                // discard node bit vectors
+                if(discard && m_sparse) {
+                    m_nodes.clear(level);
+                } else if(discard) {
+                    const size_t num_level_nodes = 1ULL << level;
                     for(size_t i = 0; i < num_level_nodes; i++) {
-                        const size_t node_id = first_level_node + (bit_reversal ? bitrev(i, level) : i);
-                        auto& bv = m_bits[node_id-1];
+                        auto& bv = m_bits[num_level_nodes + i - 1];
                         bv.clear();
                         bv.shrink_to_fit();
                     }
                 }
 
-                // allocate level bv
-                const size_t local_num = input.local_num();
-                bits[level].resize(local_num);
-
-                // receive messages until local_num bits have been received
-                const size_t global_offset = ctx.rank() * bits_per_worker;
+                in_flight_reqs.push_back(ctx.ialltoallv(
+                    ex.send_buf.data(), ex.send_counts, ex.send_displs,
+                    ex.recv_buf.data(), ex.recv_counts, ex.recv_displs));
+                in_flight.push_back(std::move(ex));
+            };
 
-                std::vector<uint64_t*> recv_buffer;
+            // unpack the messages of a level whose exchange has completed
+            auto finish = [&](const size_t k) {
+                LevelExchange ex = std::move(in_flight[k]);
+                in_flight.erase(in_flight.begin() + k);
+                in_flight_reqs.erase(in_flight_reqs.begin() + k);
 
-                size_t num_received = 0;
-                while(num_received < local_num) {
-                    // probe for message (blocking)
-                    auto result = ctx.template probe<uint64_t>((int)level);
+                // the send buffer can be released as soon as the exchange completed
+                ex.send_buf.clear();
+                ex.send_buf.shrink_to_fit();
 
-                    uint64_t* msg = new uint64_t[result.size];
-                    ctx.recv(msg, result.size, result.sender, (int)level);
-                    recv_buffer.push_back(msg);
-
-                    const size_t mnum = msg[1];
-                    assert(result.size == bv64_pack_t::required_bufsize(mnum) + 2);
-                    num_received += mnum;
+                // allocate level bv
+                const size_t local_num = level_local_num[ex.level];
+                const size_t global_offset =
+                    ctx.rank() * level_bits_per_worker[ex.level];
+
+                auto& level_bv = bits[ex.level];
+                level_bv.resize(local_num);
+
+                // locate the received messages
+                std::vector<const uint64_t*> recv_msgs;
+                for(size_t pos = 0; pos < ex.recv_buf.size();) {
+                    const uint64_t* msg = ex.recv_buf.data() + pos;
+                    recv_msgs.push_back(msg);
+                    pos += bv_pack_t::required_bufsize(msg[0] - global_offset, msg[1]) + 2;
                 }
 
-#pragma omp parallel
-                {
-                    for(const uint64_t* msg : recv_buffer) {
-                        const size_t moffs = msg[0];
-                        const size_t mnum = msg[1];
-                        const size_t start = moffs - global_offset;
-                        const size_t end = start + mnum;
+                // place the messages, one message per thread
+#pragma omp parallel for schedule(nonmonotonic : dynamic, 1)
+                for(size_t i = 0; i < recv_msgs.size(); i++) {
+                    const uint64_t* msg = recv_msgs[i];
+                    const size_t moffs = msg[0];
+                    const size_t mnum = msg[1];
 
-                        // receive global interval [moffs, moffs+mnum)
-                        #ifdef DBG_MERGE
-                        #pragma omp single
-                        {
-                        ctx.cout() << "receive ["
-                            << moffs << ","
-                            << moffs + mnum
-                            << ") (" << mnum << " bits) from "
-                            << result.sender << std::endl;
-                        ctx.cout() << "got " << num_received << " / "
-                            << local_num << " bits" << std::endl;
-                        }
-                        #endif
+                    // receive global interval [moffs, moffs+mnum)
+                    #ifdef DBG_MERGE
+                    ctx.cout() << "receive ["
+                        << moffs << ","
+                        << moffs + mnum
+                        << ") (" << mnum << " bits) of level "
+                        << (ex.level+1) << std::endl;
+                    #endif
 
-                        assert(moffs >= global_offset);
-                        assert(moffs - global_offset + mnum <= local_num);
+                    assert(moffs >= global_offset);
+                    assert(moffs - global_offset + mnum <= local_num);
 
-                        omp_write_bits_vec(start, end, bits[level], [&](uint64_t const idx) {
-                            const size_t local_idx = idx - start;
-                            const uint64_t word = msg[2 + (local_idx / 64)];
-                            uint64_t const bit = ((word >> (local_idx % 64)) & 1ULL);
-                            return bit != 0;
-                        });
-                    }
+                    bv_pack_t::unpack(msg+2, level_bv, moffs - global_offset, mnum);
                 }
+            };
 
-                // this synchronization is necessary in order to maintain the
-                // outbox buffer until all messages have been received
-                ctx.synchronize();
+            // pack and send the next level while previous levels are still
+            // being exchanged, but keep at most a fixed number of levels in
+            // flight to bound the buffer memory
+            for(size_t level = 1; level < height; level++) {
+                ctx.cout_master() << "level " << (level+1) << " ..." << std::endl;
 
-                // clean up
-                for(const auto& group : msg_buf) {
-                    for(const auto& msg_data : group) {
-                        delete[] msg_data.msg;
-                    }
+                while(in_flight.size() >= MERGE_LEVELS_IN_FLIGHT) {
+                    finish(ctx.wait_any(in_flight_reqs));
                 }
-                for(const uint64_t* msg : recv_buffer) {
-                    delete[] msg;
+
+                post(level);
+
+                // finish completed levels early to release their buffers
+                auto completed = ctx.test_some(in_flight_reqs);
+                std::sort(completed.begin(), completed.end());
+                for(auto it = completed.rbegin(); it != completed.rend(); ++it) {
+                    finish(*it);
                 }
-                
+            }
+
+            while(!in_flight.empty()) {
+                finish(ctx.wait_any(in_flight_reqs));
             }
         }
 
         if(discard) {
             m_bits.clear();
             m_bits.shrink_to_fit();
+            m_nodes = NodeDirectory();
         }
     }
 };
@@ -0,0 +1,395 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BIT_EXTRACT_X86
+#include <immintrin.h>
+
+// the instruction sets of the vector kernels, which are enabled per function,
+// so that the binary runs on any CPU and uses the best kernels it supports
+#define BIT_EXTRACT_AVX2 __attribute__((target("avx2,bmi,bmi2,popcnt")))
+#define BIT_EXTRACT_AVX512 __attribute__((target("avx512f,avx512bw,avx2,bmi,bmi2,popcnt")))
+#define BIT_EXTRACT_POPCNT __attribute__((target("popcnt")))
+#define BIT_EXTRACT_VPOPCNTDQ __attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+#endif
+
+// word-parallel extraction of level bits from arrays of symbols
+// a 64-symbol block is turned into one bit vector word at a time, using
+// AVX-512 mask compares or AVX2 shifts and movemask (after packing wider
+// symbols to bytes) and BMI2 pext, with portable fallbacks otherwise
+// the kernels are chosen at run time by dispatch, which calls a function
+// with the operations of the CPU's instruction set
+namespace bit_extract {
+
+// whether the symbols can be processed by the vector kernels
+template<typename sym_t>
+static constexpr bool VECTORIZABLE =
+    std::is_integral<sym_t>::value && std::is_unsigned<sym_t>::value && sizeof(sym_t) <= 4;
+
+enum class isa_t { scalar, avx2, avx512 };
+
+// the instruction set whose kernels are used, determined once at start-up
+// the environment variable HPWT_ISA (scalar, avx2 or avx512) can restrict
+// it, e.g., to compare the kernels
+inline isa_t cpu_isa() {
+    static const isa_t isa = [] {
+        isa_t best = isa_t::scalar;
+#ifdef BIT_EXTRACT_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt")) {
+            if (__builtin_cpu_supports("avx512bw")) {
+                best = isa_t::avx512;
+            } else if (__builtin_cpu_supports("avx2")) {
+                best = isa_t::avx2;
+            }
+        }
+#endif
+        const char* cap = std::getenv("HPWT_ISA");
+        if (cap && std::strcmp(cap, "scalar") == 0) {
+            best = isa_t::scalar;
+        } else if (cap && std::strcmp(cap, "avx2") == 0 && best == isa_t::avx512) {
+            best = isa_t::avx2;
+        }
+        return best;
+    }();
+    return isa;
+}
+
+// reverses the order of the bits of x, which translates between the
+// movemask order (first symbol in the least significant bit) and the
+// bit vector order (first symbol in the most significant bit)
+inline uint64_t reverse_bits(uint64_t x) {
+    x = __builtin_bswap64(x);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+    return x;
+}
+
+// the operations on 64-symbol blocks, see avx512_ops for their semantics
+struct scalar_ops {
+    // whether node bits can be extracted from a block without a loop over
+    // the symbols, i.e., the operations are vectorized
+    static constexpr bool WORD_PARALLEL = false;
+
+    template<typename sym_t>
+    static inline uint64_t bits_lsb_first(const sym_t* s, const size_t bit) {
+        uint64_t word = 0;
+        for (size_t k = 0; k < 64; k++) {
+            word |= ((uint64_t(s[k]) >> bit) & 1ULL) << k;
+        }
+        return word;
+    }
+
+    template<typename sym_t>
+    static inline uint64_t matches_lsb_first(const sym_t* s, const size_t rsh, const size_t v) {
+        uint64_t word = 0;
+        for (size_t k = 0; k < 64; k++) {
+            word |= uint64_t((size_t(s[k]) >> rsh) == v) << k;
+        }
+        return word;
+    }
+
+    static inline uint64_t compress_bits(uint64_t x, uint64_t m) {
+        uint64_t r = 0;
+        for (uint64_t b = 1; m; b <<= 1) {
+            if (x & m & -m) r |= b;
+            m &= m - 1;
+        }
+        return r;
+    }
+};
+
+#ifdef BIT_EXTRACT_X86
+// the lane transformations of the vector kernels, which are functors rather
+// than lambdas, as lambdas do not inherit the instruction set of the function
+// they are defined in
+
+// moves bit `bit` of every lane into its most significant bit, bytes are
+// shifted as 16-bit lanes, which moves the bits of both halves alike
+template<typename sym_t>
+struct avx2_shift {
+    __m128i sh;
+
+    BIT_EXTRACT_AVX2 inline __m256i operator()(const __m256i x) const {
+        if constexpr (sizeof(sym_t) == 4) {
+            return _mm256_sll_epi32(x, sh);
+        } else {
+            return _mm256_sll_epi16(x, sh);
+        }
+    }
+};
+
+// sets the lanes whose masked value equals the prefix
+template<typename sym_t>
+struct avx2_prefix_eq {
+    __m256i m, p;
+
+    BIT_EXTRACT_AVX2 inline __m256i operator()(const __m256i x) const {
+        if constexpr (sizeof(sym_t) == 1) {
+            return _mm256_cmpeq_epi8(_mm256_and_si256(x, m), p);
+        } else if constexpr (sizeof(sym_t) == 2) {
+            return _mm256_cmpeq_epi16(_mm256_and_si256(x, m), p);
+        } else {
+            return _mm256_cmpeq_epi32(_mm256_and_si256(x, m), p);
+        }
+    }
+};
+
+template<typename sym_t>
+BIT_EXTRACT_AVX2 inline __m256i avx2_set1(const sym_t x) {
+    if constexpr (sizeof(sym_t) == 1) {
+        return _mm256_set1_epi8(char(x));
+    } else if constexpr (sizeof(sym_t) == 2) {
+        return _mm256_set1_epi16(short(x));
+    } else {
+        return _mm256_set1_epi32(int(x));
+    }
+}
+
+struct avx2_ops {
+    static constexpr bool WORD_PARALLEL = true;
+
+    // the most significant bits of the lanes of the 32 symbols s[0, 32),
+    // transformed by f, with the first symbol in the least significant bit
+    template<typename sym_t, typename f_t>
+    BIT_EXTRACT_AVX2 static inline uint32_t movemask32(const sym_t* s, const f_t& f) {
+        const __m256i* v = reinterpret_cast<const __m256i*>(s);
+        if constexpr (sizeof(sym_t) == 1) {
+            return uint32_t(_mm256_movemask_epi8(f(_mm256_loadu_si256(v))));
+        } else if constexpr (sizeof(sym_t) == 2) {
+            // signed saturation keeps the most significant bit,
+            // packing interleaves the 128-bit lanes
+            const __m256i x = _mm256_packs_epi16(
+                f(_mm256_loadu_si256(v)), f(_mm256_loadu_si256(v + 1)));
+            return uint32_t(_mm256_movemask_epi8(_mm256_permute4x64_epi64(x, 0xD8)));
+        } else {
+            const __m256i x = _mm256_packs_epi16(
+                _mm256_packs_epi32(f(_mm256_loadu_si256(v)), f(_mm256_loadu_si256(v + 1))),
+                _mm256_packs_epi32(f(_mm256_loadu_si256(v + 2)), f(_mm256_loadu_si256(v + 3))));
+            const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+            return uint32_t(_mm256_movemask_epi8(_mm256_permutevar8x32_epi32(x, order)));
+        }
+    }
+
+    template<typename sym_t, typename f_t>
+    BIT_EXTRACT_AVX2 static inline uint64_t movemask64(const sym_t* s, const f_t& f) {
+        return uint64_t(movemask32(s, f)) | (uint64_t(movemask32(s + 32, f)) << 32);
+    }
+
+    template<typename sym_t>
+    BIT_EXTRACT_AVX2 static inline uint64_t bits_lsb_first(const sym_t* s, const size_t bit) {
+        if constexpr (VECTORIZABLE<sym_t>) {
+            const avx2_shift<sym_t> f { _mm_cvtsi32_si128(int(8 * sizeof(sym_t) - 1 - bit)) };
+            return movemask64(s, f);
+        } else {
+            return scalar_ops::bits_lsb_first(s, bit);
+        }
+    }
+
+    template<typename sym_t>
+    BIT_EXTRACT_AVX2 static inline uint64_t matches_lsb_first(const sym_t* s, const size_t rsh, const size_t v) {
+        if constexpr (VECTORIZABLE<sym_t>) {
+            // compare the masked prefix, which also works for bytes
+            const avx2_prefix_eq<sym_t> f {
+                avx2_set1(sym_t(~((uint64_t(1) << rsh) - 1))),
+                avx2_set1(sym_t(v << rsh)) };
+            return movemask64(s, f);
+        } else {
+            return scalar_ops::matches_lsb_first(s, rsh, v);
+        }
+    }
+
+    BIT_EXTRACT_AVX2 static inline uint64_t compress_bits(uint64_t x, uint64_t m) {
+        return _pext_u64(x, m);
+    }
+};
+
+// the mask of the lanes that have any of the bits of t set
+template<typename sym_t>
+struct avx512_test {
+    __m512i t;
+
+    BIT_EXTRACT_AVX512 inline uint64_t operator()(const __m512i x) const {
+        if constexpr (sizeof(sym_t) == 1) {
+            return _mm512_test_epi8_mask(x, t);
+        } else if constexpr (sizeof(sym_t) == 2) {
+            return _mm512_test_epi16_mask(x, t);
+        } else {
+            return _mm512_test_epi32_mask(x, t);
+        }
+    }
+};
+
+// the mask of the lanes whose masked value equals the prefix
+template<typename sym_t>
+struct avx512_prefix_eq {
+    __m512i m, p;
+
+    BIT_EXTRACT_AVX512 inline uint64_t operator()(const __m512i x) const {
+        if constexpr (sizeof(sym_t) == 1) {
+            return _mm512_cmpeq_epi8_mask(_mm512_and_si512(x, m), p);
+        } else if constexpr (sizeof(sym_t) == 2) {
+            return _mm512_cmpeq_epi16_mask(_mm512_and_si512(x, m), p);
+        } else {
+            return _mm512_cmpeq_epi32_mask(_mm512_and_si512(x, m), p);
+        }
+    }
+};
+
+template<typename sym_t>
+BIT_EXTRACT_AVX512 inline __m512i avx512_set1(const sym_t x) {
+    if constexpr (sizeof(sym_t) == 1) {
+        return _mm512_set1_epi8(char(x));
+    } else if constexpr (sizeof(sym_t) == 2) {
+        return _mm512_set1_epi16(short(x));
+    } else {
+        return _mm512_set1_epi32(int(x));
+    }
+}
+
+struct avx512_ops {
+    static constexpr bool WORD_PARALLEL = true;
+
+    // the mask of f applied to the 64 symbols s[0, 64), which yields one mask
+    // bit per lane, with the first symbol in the least significant bit
+    template<typename sym_t, typename f_t>
+    BIT_EXTRACT_AVX512 static inline uint64_t mask64(const sym_t* s, const f_t& f) {
+        constexpr size_t lanes = 64 / sizeof(sym_t);
+        uint64_t mask = 0;
+        for (size_t k = 0; k < 64; k += lanes) {
+            mask |= f(_mm512_loadu_si512(s + k)) << k;
+        }
+        return mask;
+    }
+
+    // bit k of the result is bit `bit` of s[k], for the 64 symbols s[0, 64)
+    template<typename sym_t>
+    BIT_EXTRACT_AVX512 static inline uint64_t bits_lsb_first(const sym_t* s, const size_t bit) {
+        if constexpr (VECTORIZABLE<sym_t>) {
+            const avx512_test<sym_t> f { avx512_set1(sym_t(1U << bit)) };
+            return mask64(s, f);
+        } else {
+            return scalar_ops::bits_lsb_first(s, bit);
+        }
+    }
+
+    // bit k of the result is set iff s[k] >> rsh == v, for the 64 symbols s[0, 64)
+    template<typename sym_t>
+    BIT_EXTRACT_AVX512 static inline uint64_t matches_lsb_first(const sym_t* s, const size_t rsh, const size_t v) {
+        if constexpr (VECTORIZABLE<sym_t>) {
+            // compare the masked prefix, which also works for bytes
+            const avx512_prefix_eq<sym_t> f {
+                avx512_set1(sym_t(~((uint64_t(1) << rsh) - 1))),
+                avx512_set1(sym_t(v << rsh)) };
+            return mask64(s, f);
+        } else {
+            return scalar_ops::matches_lsb_first(s, rsh, v);
+        }
+    }
+
+    // collects the bits of x selected by m into the low bits of the result,
+    // keeping their order
+    BIT_EXTRACT_AVX512 static inline uint64_t compress_bits(uint64_t x, uint64_t m) {
+        return _pext_u64(x, m);
+    }
+};
+
+// the functions that run f with the operations of an instruction set,
+// f is inlined so that the operations are inlined into its loops, and it is
+// passed by value, so that its captures are not reloaded after every store
+template<typename f_t>
+BIT_EXTRACT_AVX2 __attribute__((flatten)) void run_avx2(f_t f) {
+    f(avx2_ops());
+}
+
+template<typename f_t>
+BIT_EXTRACT_AVX512 __attribute__((flatten)) void run_avx512(f_t f) {
+    f(avx512_ops());
+}
+#endif
+
+// calls f(ops) with the operations of the CPU's instruction set
+// f should be a loop over many blocks, as the call is not inlined
+template<typename f_t>
+inline void dispatch(f_t f) {
+    switch (cpu_isa()) {
+#ifdef BIT_EXTRACT_X86
+    case isa_t::avx512: run_avx512(f); break;
+    case isa_t::avx2: run_avx2(f); break;
+#endif
+    default: f(scalar_ops()); break;
+    }
+}
+
+// the bit vector word holding bit `bit` of the num <= 64 symbols s[0, num),
+// starting at the most significant bit
+template<typename ops, typename sym_t>
+inline uint64_t bits_word(const sym_t* s, const size_t num, const size_t bit) {
+    if (num == 64) {
+        return reverse_bits(ops::bits_lsb_first(s, bit));
+    }
+
+    uint64_t word = 0;
+    for (size_t k = 0; k < num; k++) {
+        word |= ((uint64_t(s[k]) >> bit) & 1ULL) << (63ULL - k);
+    }
+    return word;
+}
+
+#ifdef BIT_EXTRACT_X86
+// counts the set bits of the words w[0, num), eight words at a time
+BIT_EXTRACT_VPOPCNTDQ inline size_t popcount_words_vpopcntdq(const uint64_t* w, const size_t num) {
+    __m512i sum = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(_mm512_loadu_si512(w + i)));
+    }
+
+    uint64_t lanes[8];
+    _mm512_storeu_si512(lanes, sum);
+
+    size_t ones = 0;
+    for (size_t k = 0; k < 8; k++) {
+        ones += lanes[k];
+    }
+    for (; i < num; i++) {
+        ones += _mm_popcnt_u64(w[i]);
+    }
+    return ones;
+}
+
+BIT_EXTRACT_POPCNT inline size_t popcount_words_popcnt(const uint64_t* w, const size_t num) {
+    size_t ones = 0;
+    for (size_t i = 0; i < num; i++) {
+        ones += _mm_popcnt_u64(w[i]);
+    }
+    return ones;
+}
+#endif
+
+// counts the set bits of the words w[0, num)
+inline size_t popcount_words(const uint64_t* w, const size_t num) {
+#ifdef BIT_EXTRACT_X86
+    // the vector kernels imply popcnt
+    static const bool vpopcntdq = cpu_isa() == isa_t::avx512 &&
+        __builtin_cpu_supports("avx512vpopcntdq");
+    if (vpopcntdq) {
+        return popcount_words_vpopcntdq(w, num);
+    } else if (cpu_isa() != isa_t::scalar) {
+        return popcount_words_popcnt(w, num);
+    }
+#endif
+    size_t ones = 0;
+    for (size_t i = 0; i < num; i++) {
+        ones += __builtin_popcountll(w[i]);
+    }
+    return ones;
+}
+
+} // namespace bit_extract
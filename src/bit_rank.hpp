@@ -5,6 +5,8 @@
 #include <cstdint>
 #include <vector>
 
+#include <distwt/mpi/bit_vector.hpp>
+
 /// \brief A space efficient data structure for answering rank queries on a bit vector in constant time.
 ///
 /// A rank query counts the number of set or unset bits, respectively, from the beginning up to a given position.
@@ -42,16 +44,10 @@ private:
     static constexpr size_t SUPERBLOCK_SIZE = 1ULL << SUPERBLOCK_WIDTH;
     static constexpr size_t BLOCKS_PER_SUPERBLOCK = SUPERBLOCK_SIZE / 64ULL;
     
-    const std::vector<bool>* m_bv;
+    const bv_t* m_bv;
 
     uint64_t block64(const size_t i) const {
-        // read the 64 bits... afaik, there is no better way of doing this, because std::vector<bool> does not provide a data() pointer
-        uint64_t w = 0;
-        const size_t start = i * 64ULL;
-        for(size_t j = start; j < start + 64ULL; j++) {
-            w = (w << 1) | (*m_bv)[j];
-        }
-        return w;
+        return m_bv->data()[i];
     }
 
     std::vector<uint16_t> m_blocks; // the template integer must at least fit integers of SUPERBLOCK_WIDTH bits
@@ -61,7 +57,7 @@ public:
 
     /// \brief Constructs the rank data structure for the given bit vector.
     /// \param bv the bit vector
-    bit_rank(const std::vector<bool>& bv) : m_bv(&bv) {
+    bit_rank(const bv_t& bv) : m_bv(&bv) {
         const size_t n = m_bv->size();
         const size_t num_blocks = idiv_ceil(n, 64ULL);
         const size_t num_superblocks = idiv_ceil(n, SUPERBLOCK_SIZE);
@@ -3,21 +3,36 @@
 #include <omp.h>
 #include <vector>
 
+#include <distwt/mpi/bit_vector.hpp>
+#include <src/bit_extract.hpp>
+
 // one bit vector per node
-using wt_bits_t = std::vector<std::vector<bool>>;
+using wt_bits_t = std::vector<bv_t>;
 
+// builds the word for the bits [start, start + size) of the same word
+template <typename loop_body_t>
+inline uint64_t build_bits_word(uint64_t const start, uint64_t const size, loop_body_t body) {
+    uint64_t word = 0ULL;
+    for (uint64_t i = 0; i < size; ++i) {
+        uint64_t const bit = body(start + i);
+        word |= bit << (63ULL - ((start + i) & 63ULL));
+    }
+    return word;
+}
+
+// writes the bits [start, end) of level_bv, which must not have been set before
+// words that are only partially covered are merged, all others are overwritten
 template <typename loop_body_t>
 inline void omp_write_bits_vec(uint64_t start, uint64_t end, bv_t& level_bv, loop_body_t body) {
     const auto omp_rank = omp_get_thread_num();
     const auto omp_size = omp_get_num_threads();
+    uint64_t* const words = level_bv.data();
 
     uint64_t const start_filler = start & 63ULL;
     if(start_filler) {
         const size_t end_fill = std::min(uint64_t(64ULL) - start_filler, end - start);
         if((omp_rank + 1) == omp_size) {
-            for (size_t i = 0; i < end_fill; i++) {
-                level_bv[start + i] = body(start + i);
-            }
+            words[start >> 6] |= build_bits_word(start, end_fill, body);
         }
         start += end_fill;
     }
@@ -25,22 +40,68 @@ inline void omp_write_bits_vec(uint64_t start, uint64_t end, bv_t& level_bv, loo
 #pragma omp for
     for (int64_t scur_pos = start; scur_pos <= (int64_t(end) - 64); scur_pos += 64) {
         DCHECK(scur_pos >= 0);
-        for (size_t i = 0; i < 64; i++) {
-            level_bv[scur_pos + i] = body(scur_pos + i);
-        }
+        words[scur_pos >> 6] = build_bits_word(scur_pos, 64, body);
     }
 
     uint64_t const remainder = (end - start) & 63ULL;
     if (remainder && ((omp_rank + 1) == omp_size)) {
         const auto scur_pos = end - remainder;
-        for (size_t i = 0; i < remainder; i++) {
-            DCHECK((scur_pos + i) >= start);
-            DCHECK((scur_pos + i) < end);
-            level_bv[scur_pos + i] = body(scur_pos + i);
+        DCHECK(scur_pos >= start);
+        words[scur_pos >> 6] |= build_bits_word(scur_pos, remainder, body);
+    }
+}
+
+// like omp_write_bits_vec, but the bits of [start, end) are bit `bit` of the
+// symbols syms[start, end), which are extracted a word at a time
+// fill(i, num) is called for the symbols [i, i + num) of every word before
+// their bits are extracted, e.g., to compute them
+template <typename sym_t, typename fill_t>
+inline void omp_extract_bits_vec(uint64_t start, uint64_t end, bv_t& level_bv,
+                                 const sym_t* syms, const size_t bit, fill_t fill) {
+    const auto omp_rank = omp_get_thread_num();
+    const auto omp_size = omp_get_num_threads();
+    uint64_t* const words = level_bv.data();
+
+    // the partial words at the boundaries
+    auto word = [&](const uint64_t i, const uint64_t num) {
+        fill(i, num);
+        return bit_extract::bits_word<bit_extract::scalar_ops>(syms + i, num, bit) >> (i & 63ULL);
+    };
+
+    uint64_t const start_filler = start & 63ULL;
+    if(start_filler) {
+        const size_t end_fill = std::min(uint64_t(64ULL) - start_filler, end - start);
+        if((omp_rank + 1) == omp_size) {
+            words[start >> 6] |= word(start, end_fill);
+        }
+        start += end_fill;
+    }
+
+    // all threads run the same kernels, so they all reach the loop
+    // fill is copied, so that its captures can be kept in registers
+    bit_extract::dispatch([&, fill](auto ops) {
+#pragma omp for
+        for (int64_t scur_pos = start; scur_pos <= (int64_t(end) - 64); scur_pos += 64) {
+            DCHECK(scur_pos >= 0);
+            fill(scur_pos, 64);
+            words[scur_pos >> 6] = bit_extract::bits_word<decltype(ops)>(syms + scur_pos, 64, bit);
         }
+    });
+
+    uint64_t const remainder = (end - start) & 63ULL;
+    if (remainder && ((omp_rank + 1) == omp_size)) {
+        const auto scur_pos = end - remainder;
+        DCHECK(scur_pos >= start);
+        words[scur_pos >> 6] |= word(scur_pos, remainder);
     }
 }
 
+template <typename sym_t>
+inline void omp_extract_bits_vec(uint64_t start, uint64_t end, bv_t& level_bv,
+                                 const sym_t* syms, const size_t bit) {
+    omp_extract_bits_vec(start, end, level_bv, syms, bit, [](uint64_t, uint64_t){});
+}
+
 template <typename loop_body_t>
 inline void omp_write_bits_level(const uint64_t level, wt_bits_t& bits, loop_body_t body) {
     const size_t num_nodes_level = 1ULL << level;
@@ -55,13 +116,50 @@ inline void omp_write_bits_level(const uint64_t level, wt_bits_t& bits, loop_bod
         const size_t bits_offset = std::accumulate(
             std::next(bits.begin(), nodes_offset),
             std::next(bits.begin(), glob_node),
-            0,
+            size_t(0),
             [](const size_t acc, const auto& vec) {
                 return acc + vec.size();
             });
 
-        for (size_t i = 0; i < num_bits; i++) {
-            bits[glob_node][i] = body(bits_offset + i);
+        uint64_t* const words = bits[glob_node].data();
+        for (size_t i = 0; i < num_bits; i += 64) {
+            const size_t num = std::min(num_bits - i, size_t(64));
+            words[i >> 6] = build_bits_word(i, num, [&](uint64_t const j) {
+                return uint64_t(body(bits_offset + j));
+            });
         }
     }
 }
+
+// like omp_write_bits_level, but the bits of the level are bit `bit` of the
+// symbols syms[0, level size), which are extracted a word at a time
+template <typename sym_t>
+inline void omp_extract_bits_level(const uint64_t level, wt_bits_t& bits,
+                                   const sym_t* syms, const size_t bit) {
+    const size_t num_nodes_level = 1ULL << level;
+    const size_t nodes_offset = num_nodes_level - 1;
+
+#pragma omp for
+    for (size_t node = 0; node < num_nodes_level; node++) {
+        const size_t glob_node = nodes_offset + node;
+        const size_t num_bits = bits[glob_node].size();
+
+        // count number of bits in previous nodes
+        const size_t bits_offset = std::accumulate(
+            std::next(bits.begin(), nodes_offset),
+            std::next(bits.begin(), glob_node),
+            size_t(0),
+            [](const size_t acc, const auto& vec) {
+                return acc + vec.size();
+            });
+
+        uint64_t* const words = bits[glob_node].data();
+        const sym_t* const node_syms = syms + bits_offset;
+        bit_extract::dispatch([&](auto ops) {
+            for (size_t i = 0; i < num_bits; i += 64) {
+                const size_t num = std::min(num_bits - i, size_t(64));
+                words[i >> 6] = bit_extract::bits_word<decltype(ops)>(node_syms + i, num, bit);
+            }
+        });
+    }
+}
@@ -1,52 +1,90 @@
 #include "bit_rank.hpp"
 #include <distwt/common/binary_io.hpp>
-#include <distwt/common/bv64.hpp>
 #include <distwt/common/effective_alphabet.hpp>
+#include <distwt/common/huffman.hpp>
 #include <distwt/common/util.hpp>
-#include <distwt/mpi/wt.hpp>
+#include <distwt/mpi/wm.hpp>
 #include <iomanip>
+#include <numeric>
 #include <string>
 #include <tlx/math/div_ceil.hpp>
 
 template <typename sym_t>
 static void
-validate_distwt(const std::string& input, const std::string& output, const size_t comm_size, const size_t prefix) {
+validate_distwt(const std::string& input, const std::string& output, const size_t comm_size, const size_t prefix,
+                const bool single_file = false, const bool matrix = false, const bool huffman = false) {
     const size_t input_size = std::min(util::file_size(input), prefix) / sizeof(sym_t);
-    const auto size_per_worker = tlx::div_ceil(input_size, comm_size);
+
+    // a single file per level is read like the output of one worker
+    const size_t num_files = single_file ? 1 : comm_size;
+    const auto size_per_worker = tlx::div_ceil(input_size, num_files);
 
     Histogram<sym_t> hist(output + "." + WaveletTreeBase::histogram_extension());
     EffectiveAlphabetBase<sym_t> ea(hist);
 
-    const size_t tree_height =
-        tlx::integer_log2_ceil(hist.size() - 1); // WaveletTreeBase::wt_height
+    // the levels of a Huffman-shaped tree get shorter with increasing depth
+    HuffmanCode code;
+    std::vector<size_t> node_sizes;
+    if (huffman) {
+        code = HuffmanCode(output + "." + HuffmanCode::code_extension());
+        if (code.sigma() != hist.size()) {
+            std::cerr << "Error: expected " << hist.size() << " Huffman codes, but got "
+                      << code.sigma() << '\n';
+            return;
+        }
+
+        for (const auto size : code.node_sizes(hist)) {
+            node_sizes.push_back(size);
+        }
+    }
+
+    const size_t tree_height = huffman ? code.height()
+                                       : tlx::integer_log2_ceil(hist.size()); // WaveletTreeBase::wt_height
+
+    std::vector<size_t> level_sizes(tree_height, input_size);
+    if (huffman) {
+        for (size_t level = 0; level < tree_height; level++) {
+            const size_t num_level_nodes = 1ULL << level;
+            level_sizes[level] = std::accumulate(node_sizes.begin() + num_level_nodes - 1,
+                                                 node_sizes.begin() + 2 * num_level_nodes - 1, size_t(0));
+        }
+    }
 
     // read wavelet tree
     WaveletTree::bits_t wt;
     for (size_t level = 0; level < tree_height; level++) {
         wt.emplace_back();
-        size_t bits_left = input_size;
-        for (size_t rank = 0; rank < comm_size; rank++) {
+        size_t bits_left = level_sizes[level];
+        const size_t level_size_per_worker =
+            huffman ? std::max(tlx::div_ceil(level_sizes[level], num_files), size_t(1)) : size_per_worker;
+        for (size_t rank = 0; rank < num_files; rank++) {
             // construct local filename
             std::string filename;
             {
                 std::ostringstream ss;
-                ss << output << std::setw(4) << std::setfill('0') << rank << '.'
-                   << WaveletTreeBase::level_extension(level);
+                ss << output;
+                if (!single_file) {
+                    ss << std::setw(4) << std::setfill('0') << rank;
+                }
+                ss << '.' << WaveletTreeBase::level_extension(level);
                 filename = ss.str();
             }
 
+            const size_t num = std::min(level_size_per_worker, bits_left);
+            std::vector<uint64_t> words(bv_t::num_words(num));
+
             binary::FileReader reader(filename);
-            bv64_t bitbuf(reader.read<uint64_t>());
-            size_t x = 0;
-            for (size_t i = 0; i < std::min(size_per_worker, bits_left); i++) {
-                if (x >= 64ULL) {
-                    bitbuf = bv64_t(reader.read<uint64_t>());
-                    x = 0;
-                }
-                wt.back().push_back(bitbuf[63ULL - (x++)]);
+            for (auto& word : words) {
+                word = reader.read<uint64_t>();
             }
 
-            bits_left -= std::min(size_per_worker, bits_left);
+            // append the worker's bits
+            auto& level_bits = wt.back();
+            const size_t offs = level_bits.size();
+            level_bits.resize(offs + num);
+            copy_bits(level_bits.data(), offs, words.data(), 0, num);
+
+            bits_left -= num;
         }
     }
 
@@ -55,9 +93,24 @@ validate_distwt(const std::string& input, const std::string& output, const size_
         level_ranks.emplace_back(wt[level]);
     }
 
-    // reconstruct input file and compare with input file
-    binary::FileReader file_reader(input);
-    for (size_t i = 0; i < input_size; i++) {
+    // read number of zeros per level of a wavelet matrix
+    std::vector<size_t> zeros;
+    if (matrix) {
+        binary::FileReader reader(output + "." + WaveletMatrix::zeros_extension());
+        zeros.resize(reader.read<size_t>());
+        for (auto& z : zeros) {
+            z = reader.read<size_t>();
+        }
+
+        if (zeros.size() != tree_height) {
+            std::cerr << "Error: expected " << tree_height << " zero counts, but got "
+                      << zeros.size() << '\n';
+            return;
+        }
+    }
+
+    // decodes the i-th symbol from the wavelet tree
+    auto decode_tree = [&](const size_t i) {
         sym_t value = 0;
         size_t idx = i;
         size_t level_begin = 0;
@@ -88,6 +141,70 @@ validate_distwt(const std::string& input, const std::string& output, const size_
             }
             idx += level_begin;
         }
+        return value;
+    };
+
+    // decodes the i-th symbol from the wavelet matrix
+    auto decode_matrix = [&](const size_t i) {
+        sym_t value = 0;
+        size_t idx = i;
+        for (size_t level = 0; level < tree_height; level++) {
+            const auto bit = wt[level][idx];
+            value <<= 1;
+            value |= bit;
+
+            // zeros precede the ones on the next level
+            if (!bit) {
+                idx = idx > 0 ? level_ranks[level].rank0(idx - 1) : 0;
+            } else {
+                idx = zeros[level] + (idx > 0 ? level_ranks[level].rank1(idx - 1) : 0);
+            }
+        }
+        return value;
+    };
+
+    // decodes the i-th symbol from the Huffman-shaped wavelet tree,
+    // whose nodes are located in their levels by their global sizes
+    std::vector<size_t> node_offs(node_sizes.size());
+    std::vector<sym_t> leaf_symbols;
+    if (huffman) {
+        for (size_t level = 0; level < tree_height; level++) {
+            const size_t num_level_nodes = 1ULL << level;
+            size_t offs = 0;
+            for (size_t node_id = num_level_nodes; node_id < 2 * num_level_nodes; node_id++) {
+                node_offs[node_id - 1] = offs;
+                offs += node_sizes[node_id - 1];
+            }
+        }
+
+        leaf_symbols.resize(2ULL << tree_height);
+        for (size_t r = 0; r < code.sigma(); r++) {
+            leaf_symbols[(1ULL << code.length(r)) | code.code(r)] = sym_t(r);
+        }
+    }
+
+    auto decode_huffman = [&](const size_t i) {
+        size_t node_id = 1;
+        size_t idx = i;
+        for (size_t level = 0; node_id <= node_sizes.size() && node_sizes[node_id - 1] > 0; level++) {
+            const size_t begin = node_offs[node_id - 1];
+            const size_t pos = begin + idx;
+            const auto bit = wt[level][pos];
+
+            // count the bits equal to bit preceding idx in the node
+            auto rank = [&](const size_t j) {
+                return j > 0 ? (bit ? level_ranks[level].rank1(j - 1) : level_ranks[level].rank0(j - 1)) : 0;
+            };
+            idx = rank(pos) - rank(begin);
+            node_id = 2 * node_id + bit;
+        }
+        return leaf_symbols[node_id];
+    };
+
+    // reconstruct input file and compare with input file
+    binary::FileReader file_reader(input);
+    for (size_t i = 0; i < input_size; i++) {
+        const sym_t value = matrix ? decode_matrix(i) : huffman ? decode_huffman(i) : decode_tree(i);
 
         // read char from file
         const sym_t file_value = ea.map(file_reader.read<sym_t>());
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <distwt/common/effective_alphabet.hpp>
+#include <distwt/common/util.hpp>
 #include <distwt/common/wt.hpp>
 #include <pwm/arrays/flat_two_dim_array.hpp>
 #include <pwm/arrays/helper_array.hpp>
@@ -9,7 +10,11 @@
 #include <algorithm>
 #include <cassert>
 #include <omp.h>
+#include <type_traits>
+#include <tlx/math/div_ceil.hpp>
 #include <tlx/math/integer_log2.hpp>
+#include <src/alignment_allocator.hpp>
+#include <src/bit_extract.hpp>
 #include <src/omp_write_bits.hpp>
 
 struct no_init_helper_array_config {
@@ -26,12 +31,149 @@ using no_init_helper_array = flat_two_dim_array<uint64_t, no_init_helper_array_c
 class wt_ppc_nodebased {
 public:
 
-// prefix counting for wavelet subtree
-// combination of wt_pc and ppc
-template <typename sym_t, typename idx_t, typename A>
-static void start(wt_bits_t& bits, const std::vector<sym_t, A>& text, const size_t h) {
+// the maximum tree height for which the text can be bit-sliced
+static constexpr size_t PACKED_MAX_HEIGHT = 4;
+
+// the deepest level whose node bits are extracted from a block of the text
+// per node rather than scattered symbol by symbol, if word parallel
+// extraction is available (the cost grows with the amount of nodes)
+static constexpr size_t WORD_PARALLEL_MAX_LEVEL = 3;
+
+// the maximum amount of nodes whose counters are kept while building a
+// group of levels by one text scan, so that the counters, the nodes'
+// current words and their pages (the nodes are allocated separately)
+// stay in the L2 cache and TLB
+static constexpr size_t FUSED_MAX_NODES = 1ULL << 10;
+
+// the maximum amount of levels built by one text scan
+static constexpr size_t FUSED_MAX_LEVELS = 4;
+
+// for trees of at least PARTITION_MIN_HEIGHT levels, the levels starting
+// with PARTITION_BITS are built from a copy of the text that is partitioned
+// by the symbols' first PARTITION_BITS bits, so that a scan only writes to
+// the nodes below one bucket at a time
+static constexpr size_t PARTITION_BITS = 10;
+static constexpr size_t PARTITION_MIN_HEIGHT = 17;
+
+// the domain decomposition keeps DD_SCRATCH_ARRAYS words per thread and node
+// (histograms, borders, heads, head words and stages), which may take at
+// most one word per DD_MAX_SCRATCH_RATIO text symbols
+static constexpr size_t DD_SCRATCH_ARRAYS = 5;
+static constexpr size_t DD_MAX_SCRATCH_RATIO = 4;
+
+private:
+
+// the first level that is built from the partitioned text,
+// h if the text is not partitioned
+static inline size_t partition_level(const size_t h) {
+    return (h >= PARTITION_MIN_HEIGHT) ? PARTITION_BITS : h;
+}
+
+// splits the levels [first, h) into ranges of up to FUSED_MAX_LEVELS
+// consecutive levels that are built by the same text scan, such that their
+// nodes do not exceed FUSED_MAX_NODES (unless a single level does) and there
+// are at least min_groups ranges, if possible
+// the levels built from the partitioned text form separate ranges, where
+// only the nodes below one bucket count
+static std::vector<std::pair<size_t, size_t>>
+fused_level_groups(const size_t first, const size_t h, const size_t min_groups) {
+    const size_t num_levels = (h > first) ? h - first : 0;
+    const size_t max_group_levels = std::clamp(
+        num_levels / std::max(min_groups, size_t(1)), size_t(1), FUSED_MAX_LEVELS);
+
+    const size_t first_partitioned = partition_level(h);
+    auto level_nodes = [&](const size_t level) {
+        return 1ULL << ((level >= first_partitioned) ? level - PARTITION_BITS : level);
+    };
+
+    std::vector<std::pair<size_t, size_t>> groups;
+    for (size_t level = first; level < h;) {
+        size_t end = level + 1;
+        size_t num_nodes = level_nodes(level);
+        while (end < h && end - level < max_group_levels && end != first_partitioned &&
+               num_nodes + level_nodes(end) <= FUSED_MAX_NODES) {
+            num_nodes += level_nodes(end);
+            ++end;
+        }
+        groups.emplace_back(level, end);
+        level = end;
+    }
+    return groups;
+}
+
+// stable partition of text[begin, end) into out[begin, end) by the first
+// PARTITION_BITS bits of the symbols, counts has 2^PARTITION_BITS entries
+template <typename sym_t>
+static void partition_text(const sym_t* text, sym_t* out, const size_t begin, const size_t end,
+                           const size_t h, uint64_t* counts) {
+    const size_t shift = h - PARTITION_BITS;
+    const size_t num_buckets = 1ULL << PARTITION_BITS;
+
+    // compiled for the kernels' instruction set, like scan_level_group
+    bit_extract::dispatch([&](auto) {
+        std::fill_n(counts, num_buckets, 0);
+        for (size_t i = begin; i < end; i++) {
+            ++counts[size_t(text[i]) >> shift];
+        }
+
+        size_t offs = begin;
+        for (size_t b = 0; b < num_buckets; b++) {
+            const size_t count = counts[b];
+            counts[b] = offs;
+            offs += count;
+        }
+
+        for (size_t i = begin; i < end; i++) {
+            out[counts[size_t(text[i]) >> shift]++] = text[i];
+        }
+    });
+}
+
+// scans the text [begin, end) and calls write(node, bit) for the node of
+// each of the K levels starting with first_level that a symbol passes,
+// where node is the heap index (node_id - 1)
+template <size_t K, typename sym_t, typename write_t>
+static inline void scan_levels(const sym_t* text, const size_t begin, const size_t end,
+                               const size_t h, const size_t first_level, write_t write) {
+    size_t glob_offs[K];
+    size_t rsh[K];
+    for (size_t k = 0; k < K; k++) {
+        glob_offs[k] = (1ULL << (first_level + k)) - 1;
+        rsh[k] = h - first_level - k;
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        const size_t c = text[i];
+        for (size_t k = 0; k < K; k++) {
+            write(glob_offs[k] + (c >> rsh[k]), (c >> (rsh[k] - 1)) & 1ULL);
+        }
+    }
+}
+
+// scan_levels for the levels [first_level, last_level)
+// the scan is scalar, but compiled for the kernels' instruction set,
+// e.g., for BMI2 shifts by the level
+template <typename sym_t, typename write_t>
+static void scan_level_group(const sym_t* text, const size_t begin, const size_t end,
+                             const size_t h, const size_t first_level, const size_t last_level,
+                             write_t write) {
+    static_assert(FUSED_MAX_LEVELS == 4);
+    bit_extract::dispatch([&, write](auto) {
+        switch (last_level - first_level) {
+        case 1: scan_levels<1>(text, begin, end, h, first_level, write); break;
+        case 2: scan_levels<2>(text, begin, end, h, first_level, write); break;
+        case 3: scan_levels<3>(text, begin, end, h, first_level, write); break;
+        case 4: scan_levels<4>(text, begin, end, h, first_level, write); break;
+        default: assert(false);
+        }
+    });
+}
+
+// prefix counting with one thread per group of levels
+// only uses up to h-1 threads, but needs no synchronization between levels
+template <typename sym_t, typename idx_t, typename root_t>
+static void start_levelwise(wt_bits_t& bits, const sym_t* text, const size_t n, const size_t h, root_t root_sym) {
 
-    const size_t n = text.size();
     const size_t sigma = 1ULL << h; // we need the next power of two!
 
     assert(h >= 1);
@@ -50,11 +192,10 @@ static void start(wt_bits_t& bits, const std::vector<sym_t, A>& text, const size
         {
             const auto shard = omp_get_thread_num();
             auto&& hist = sharded_hists[shard];
-            omp_write_bits_vec(0, n, root, [&](uint64_t const i) {
-                auto const c = text[i];
-                hist[c]++;
-                uint64_t const bit = ((c >> (h - 1)) & 1ULL);
-                return bit != 0;
+            omp_extract_bits_vec(0, n, root, text, h - 1, [&](uint64_t const i, uint64_t const num) {
+                for (uint64_t j = i; j < i + num; ++j) {
+                    hist[root_sym(j)]++;
+                }
             });
         }
 
@@ -82,38 +223,510 @@ static void start(wt_bits_t& bits, const std::vector<sym_t, A>& text, const size
 
     const int old_max_threads = omp_get_max_threads();
     const size_t used_threads = std::min(h - 1, static_cast<size_t>(old_max_threads));
-    no_init_helper_array shared_counts(used_threads, sigma / 2);
+    const size_t first_partitioned = partition_level(h);
+    const auto groups = fused_level_groups(1, h, used_threads);
+
+    // a group has at most FUSED_MAX_NODES nodes, unless it is a single level
+    // or built from the partitioned text
+    const size_t max_group_nodes = (first_partitioned < h)
+        ? sigma : std::min(sigma, std::max(sigma / 2, FUSED_MAX_NODES));
+    no_init_helper_array shared_counts(used_threads, max_group_nodes);
+
+    // the bits of the nodes' current words, which are written when complete
+    no_init_helper_array shared_stages(used_threads, max_group_nodes);
+
+    // partition the chunks of the text (the order within each node is kept)
+    std::vector<sym_t, Alignment_allocator<sym_t>> part;
+    if (first_partitioned < h) {
+        part.resize(n);
+        no_init_helper_array sharded_buckets(old_max_threads, 1ULL << PARTITION_BITS);
+
+#pragma omp parallel
+        {
+            const size_t shard = omp_get_thread_num();
+            const size_t num_shards = omp_get_num_threads();
+            partition_text(text, part.data(), (shard * n) / num_shards, ((shard + 1) * n) / num_shards,
+                h, sharded_buckets[shard].data());
+        }
+    }
 
 #pragma omp parallel num_threads(used_threads)
     {
         auto&& count = shared_counts[omp_get_thread_num()]; 
+        auto&& stage = shared_stages[omp_get_thread_num()];
 #pragma omp for schedule(nonmonotonic : dynamic, 1)
-        for (size_t level = h - 1; level > 0; --level) {
-            std::fill_n(count.data(), count.size(), 0); // reset counters
+        for (size_t g = 0; g < groups.size(); g++) {
+            // the counters of the group's nodes, starting with its first level
+            const size_t first_level = groups[g].first;
+            const size_t last_level = groups[g].second;
+            const size_t first_node = (1ULL << first_level) - 1;
+            const size_t num_nodes = (1ULL << last_level) - 1 - first_node;
+            std::fill_n(count.data(), num_nodes, 0); // reset counters
+            std::fill_n(stage.data(), num_nodes, 0);
+
+            // compute level bit vectors
+            uint64_t* const group_count = count.data();
+            uint64_t* const group_stage = stage.data();
+            scan_level_group((first_level >= first_partitioned) ? part.data() : text,
+                0, n, h, first_level, last_level,
+                [&bits, group_count, group_stage, first_node](const size_t node, const uint64_t b) {
+                    const size_t x = node - first_node;
+                    const size_t pos = group_count[x];
+                    ++group_count[x];
+
+                    // assert(pos < hist[v]);
+                    const uint64_t word = group_stage[x] | (b << (63ULL - (pos & 63ULL)));
+                    if ((pos & 63ULL) == 63ULL) {
+                        bits[node].data()[pos >> 6] = word;
+                        group_stage[x] = 0;
+                    } else {
+                        group_stage[x] = word;
+                    }
+                });
+
+            // write the incomplete last words
+            for (size_t x = 0; x < num_nodes; x++) {
+                const size_t pos = group_count[x];
+                if (pos & 63ULL) {
+                    bits[first_node + x].data()[pos >> 6] = group_stage[x];
+                }
+            }
+        }
+    }
+
+    omp_set_num_threads(old_max_threads);
+}
+
+// prefix counting with a domain decomposition of the text
+// every thread processes a contiguous chunk of the text and writes its bits
+// to the node offsets given by the prefix sum over the thread histograms
+// (like the borders in pps), which are computed for all levels at once,
+// so the threads only synchronize to merge the words they share
+template <typename sym_t, typename idx_t, typename root_t>
+static void start_domain_decomposed(wt_bits_t& bits, const sym_t* text, const size_t n, const size_t h, root_t root_sym) {
+
+    const size_t sigma = 1ULL << h; // we need the next power of two!
+
+    assert(h >= 1);
+
+    const size_t max_threads = omp_get_max_threads();
+    helper_array sharded_hists(max_threads, sigma);
+
+    // the node arrays are indexed by node_id - 1
+    no_init_helper_array sharded_borders(max_threads, sigma);
+
+    // bits that fall into the first word of a thread's node interval,
+    // this word may be shared with the previous thread and is written afterwards
+    no_init_helper_array sharded_heads(max_threads, sigma);
+    no_init_helper_array sharded_head_words(max_threads, sigma);
+
+    // the bits of the nodes' current words, which are written when complete
+    no_init_helper_array sharded_stages(max_threads, sigma);
+
+    std::vector<size_t> node_sizes(sigma);
+
+    // the threads partition their chunks of the text
+    const size_t first_partitioned = partition_level(h);
+    std::vector<sym_t, Alignment_allocator<sym_t>> part((first_partitioned < h) ? n : 0);
+    no_init_helper_array sharded_buckets(max_threads, (first_partitioned < h) ? 1ULL << PARTITION_BITS : 0);
 
+    // the upper levels are extracted block by block, the others are
+    // built in groups of levels per text scan
+    const bool word_parallel = bit_extract::VECTORIZABLE<sym_t> &&
+        bit_extract::cpu_isa() != bit_extract::isa_t::scalar;
+    const size_t first_fused = word_parallel ? std::min(WORD_PARALLEL_MAX_LEVEL + 1, h) : 1;
+    const auto groups = fused_level_groups(first_fused, h, 1);
+
+    bits[0].resize(n);
+
+#pragma omp parallel
+    {
+        const size_t shard = omp_get_thread_num();
+        const size_t num_shards = omp_get_num_threads();
+
+        // text chunk of this thread, aligned to 64 symbols so that the
+        // root level can be written without sharing words between threads
+        const size_t num_blocks = tlx::div_ceil(n, size_t(64));
+        const size_t begin = std::min(n, 64 * ((shard * num_blocks) / num_shards));
+        const size_t end = std::min(n, 64 * (((shard + 1) * num_blocks) / num_shards));
+
+        auto&& hist = sharded_hists[shard];
+        auto&& border = sharded_borders[shard];
+        auto&& head = sharded_heads[shard];
+        auto&& head_word = sharded_head_words[shard];
+        auto&& stage = sharded_stages[shard];
+
+        // write the root level and compute the chunk histogram
+        // (root_sym and the histogram span are copied into the kernels,
+        // so that their captures are not reloaded after every store)
+        uint64_t* const root = bits[0].data();
+        bit_extract::dispatch([&, root_sym, hist](auto ops) {
+            for (size_t i = begin; i < end; i += 64) {
+                const size_t num = std::min(end - i, size_t(64));
+                for (size_t j = i; j < i + num; j++) {
+                    hist[root_sym(j)]++;
+                }
+                root[i >> 6] = bit_extract::bits_word<decltype(ops)>(text + i, num, h - 1);
+            }
+        });
+
+        // count the chunk's symbols in every node, bottom-up
+        for (size_t level = h - 1; level > 0; --level) {
             const size_t glob_offs = (1ULL << level) - 1;
+            for (size_t v = 0; v < (1ULL << level); v++) {
+                const size_t x = glob_offs + v;
+                border[x] = (level + 1 == h)
+                    ? hist[2 * v] + hist[2 * v + 1]
+                    : border[2 * x + 1] + border[2 * x + 2];
+            }
+        }
 
-            // compute level bit vectors
-            const size_t rsh = h - 1 - (level - 1);
-            const size_t test = 1ULL << (h - 1 - level);
+#pragma omp barrier
+
+        // compute the node offsets of every thread, which replace the counts
+#pragma omp for
+        for (size_t x = 1; x < sigma - 1; x++) {
+            size_t offs = 0;
+            for (size_t s = 0; s < num_shards; s++) {
+                const size_t count = sharded_borders[s][x];
+                sharded_borders[s][x] = offs;
+                offs += count;
+            }
+            node_sizes[x] = offs;
+        }
+
+        // allocate nodes (not in parallel, to keep allocation counting intact)
+#pragma omp single
+        for (size_t x = 1; x < sigma - 1; x++) {
+            bits[x].resize(node_sizes[x]);
+        }
+
+        for (size_t x = 1; x < sigma - 1; x++) {
+            const size_t offs = border[x];
+            head[x] = 0;
+            head_word[x] = (offs & 63ULL) ? (offs >> 6) : UINT64_MAX;
+        }
+
+        auto write_word = [&](const size_t x, const size_t w, const uint64_t b) {
+            if (w == head_word[x]) {
+                head[x] |= b;
+            } else {
+                bits[x].data()[w] |= b;
+            }
+        };
 
-            for (size_t i = 0; i < n; i++) {
+        // the level is a compile-time constant, so that the loop over the
+        // level's nodes is unrolled and their prefixes are kept in registers
+        auto word_parallel_level = [&](auto ops, auto level_constant) {
+            using ops_t = decltype(ops);
+            constexpr size_t level = decltype(level_constant)::value;
+            constexpr size_t glob_offs = (1ULL << level) - 1;
+            const size_t rsh = h - level;
+            const size_t test_bit = h - 1 - level;
+
+            // extract the bits of every node from the block's level bits
+            size_t i = begin;
+            for (; i + 64 <= end; i += 64) {
+                const uint64_t level_bits = ops_t::bits_lsb_first(text + i, test_bit);
+                for (size_t v = 0; v < (1ULL << level); v++) {
+                    const uint64_t m = ops_t::matches_lsb_first(text + i, rsh, v);
+                    const size_t num = __builtin_popcountll(m);
+                    if (num == 0) continue;
+
+                    // the node's bits, aligned to the most significant bit
+                    const uint64_t b = bit_extract::reverse_bits(
+                        ops_t::compress_bits(level_bits, m));
+
+                    const size_t x = glob_offs + v;
+                    const size_t pos = border[x];
+                    border[x] += num;
+
+                    const size_t s = pos & 63ULL;
+                    write_word(x, pos >> 6, b >> s);
+                    if (s + num > 64) {
+                        write_word(x, (pos >> 6) + 1, b << (64 - s));
+                    }
+                }
+            }
+
+            for (; i < end; i++) {
                 const size_t c = text[i];
-                const size_t v = (c >> rsh);
+                const size_t x = glob_offs + (c >> rsh);
+                const size_t pos = border[x]++;
+                write_word(x, pos >> 6, ((c >> test_bit) & 1ULL) << (63ULL - (pos & 63ULL)));
+            }
+        };
+
+        if (word_parallel) {
+            bit_extract::dispatch([&](auto ops) {
+                if constexpr (decltype(ops)::WORD_PARALLEL) {
+                    static_assert(WORD_PARALLEL_MAX_LEVEL == 3);
+                    if (first_fused > 1) word_parallel_level(ops, std::integral_constant<size_t, 1>());
+                    if (first_fused > 2) word_parallel_level(ops, std::integral_constant<size_t, 2>());
+                    if (first_fused > 3) word_parallel_level(ops, std::integral_constant<size_t, 3>());
+                }
+            });
+        }
+
+        // compute the bit vectors of a group of levels per text scan,
+        // the nodes' words are staged and written when complete
+        if (first_partitioned < h) {
+            partition_text(text, part.data(), begin, end, h, sharded_buckets[shard].data());
+        }
+
+        const size_t first_fused_node = (1ULL << first_fused) - 1;
+        std::fill(stage.data() + first_fused_node, stage.data() + sigma - 1, 0);
 
-                const size_t node = glob_offs + v;
+        auto flush_word = [&bits, head, head_word](const size_t x, const size_t w, const uint64_t word) {
+            if (w == head_word[x]) {
+                head[x] = word;
+            } else {
+                bits[x].data()[w] = word;
+            }
+        };
 
-                const size_t pos = count[v];
-                ++count[v];
-                const bool b = c & test;
+        for (const auto& group : groups) {
+            scan_level_group((group.first >= first_partitioned) ? part.data() : text,
+                begin, end, h, group.first, group.second,
+                [border, stage, flush_word](const size_t x, const uint64_t b) {
+                    const size_t pos = border[x]++;
+                    const uint64_t word = stage[x] | (b << (63ULL - (pos & 63ULL)));
+                    if ((pos & 63ULL) == 63ULL) {
+                        flush_word(x, pos >> 6, word);
+                        stage[x] = 0;
+                    } else {
+                        stage[x] = word;
+                    }
+                });
+        }
 
-                // assert(pos < hist[v]);
-                bits[node][pos] = b;
+        // write the incomplete last words
+        for (size_t x = first_fused_node; x < sigma - 1; x++) {
+            if (border[x] & 63ULL) {
+                flush_word(x, border[x] >> 6, stage[x]);
+            }
+        }
+
+#pragma omp barrier
+
+        // merge the shared head words, one node per thread
+#pragma omp for
+        for (size_t x = 1; x < sigma - 1; x++) {
+            uint64_t* const words = bits[x].data();
+            for (size_t s = 1; s < num_shards; s++) {
+                // borders have been advanced to the end of each interval
+                const uint64_t head_bits = sharded_heads[s][x];
+                if (head_bits) {
+                    words[sharded_borders[s - 1][x] >> 6] |= head_bits;
+                }
             }
         }
     }
+}
 
-    omp_set_num_threads(old_max_threads);
+// the symbols of a bit-sliced block that belong to node v of the level,
+// i.e., whose first level bits equal v
+static inline uint64_t node_mask(const uint64_t* planes, const size_t level, const size_t v, uint64_t mask) {
+    for (size_t j = 0; j < level; j++) {
+        mask &= ((v >> (level - 1 - j)) & 1ULL) ? planes[j] : ~planes[j];
+    }
+    return mask;
+}
+
+// prefix counting on a bit-sliced text
+// every block of 64 symbols is stored in h words, where word j holds bit j
+// (counted from the most significant) of the symbols in bit vector layout,
+// so a level pass reads h bits per symbol and extracts the bits of a node
+// from a block with the mask of the symbols that match the node's prefix
+// otherwise, the threads work like in start_domain_decomposed
+// H is the height, or 0 if it is only known at run time
+template <size_t H, typename idx_t, typename root_t>
+static void start_bit_sliced(wt_bits_t& bits, const size_t n, const size_t height, root_t root_sym) {
+    const size_t h = H ? H : height;
+
+    const size_t sigma = 1ULL << h;
+
+    assert(h >= 1 && h <= PACKED_MAX_HEIGHT);
+
+    const size_t num_blocks = tlx::div_ceil(n, size_t(64));
+    std::vector<uint64_t, Alignment_allocator<uint64_t>> planes(num_blocks * h);
+
+    const size_t max_threads = omp_get_max_threads();
+    helper_array sharded_hists(max_threads, sigma);
+    no_init_helper_array sharded_borders(max_threads, sigma / 2);
+    no_init_helper_array sharded_heads(max_threads, sigma / 2);
+    no_init_helper_array sharded_head_words(max_threads, sigma / 2);
+
+    bits[0].resize(n);
+
+#pragma omp parallel
+    {
+        const size_t shard = omp_get_thread_num();
+        const size_t num_shards = omp_get_num_threads();
+
+        const size_t block_begin = (shard * num_blocks) / num_shards;
+        const size_t block_end = ((shard + 1) * num_blocks) / num_shards;
+
+        auto&& hist = sharded_hists[shard];
+        auto&& border = sharded_borders[shard];
+        auto&& head = sharded_heads[shard];
+        auto&& head_word = sharded_head_words[shard];
+
+        // the symbols of a block that are part of the text
+        auto valid_mask = [&](const size_t b) {
+            const size_t num = std::min(n - 64 * b, size_t(64));
+            return (num == 64) ? UINT64_MAX : ~(UINT64_MAX >> num);
+        };
+
+        // slice the text, count the chunk histogram and write the root level,
+        // which is the first plane (the scalar loop is compiled for the
+        // kernels' instruction set, e.g., for BMI2 shifts)
+        uint64_t* const root = bits[0].data();
+        bit_extract::dispatch([&, root_sym, hist](auto) {
+            for (size_t b = block_begin; b < block_end; b++) {
+                const size_t i = 64 * b;
+                const size_t num = std::min(n - i, size_t(64));
+
+                uint64_t p[PACKED_MAX_HEIGHT] = {0};
+                for (size_t k = 0; k < num; k++) {
+                    const size_t c = root_sym(i + k);
+                    hist[c]++;
+                    for (size_t j = 0; j < h; j++) {
+                        p[j] |= ((c >> (h - 1 - j)) & 1ULL) << (63ULL - k);
+                    }
+                }
+
+                uint64_t* const block = planes.data() + b * h;
+                for (size_t j = 0; j < h; j++) {
+                    block[j] = p[j];
+                }
+                root[b] = p[0];
+            }
+        });
+
+        for (size_t level = h - 1; level > 0; --level) {
+            const size_t num_level_nodes = (1ULL << level);
+            const size_t glob_offs = (1ULL << level) - 1;
+
+            // reduce chunk histogram to the current level
+            for (size_t v = 0; v < num_level_nodes; v++) {
+                hist[v] = hist[2 * v] + hist[2 * v + 1];
+            }
+
+#pragma omp barrier
+
+            // compute the node offsets of every thread
+#pragma omp for
+            for (size_t v = 0; v < num_level_nodes; v++) {
+                size_t offs = 0;
+                for (size_t s = 0; s < num_shards; s++) {
+                    sharded_borders[s][v] = offs;
+                    offs += sharded_hists[s][v];
+                }
+            }
+
+            // allocate nodes (not in parallel, to keep allocation counting intact)
+#pragma omp single
+            for (size_t v = 0; v < num_level_nodes; v++) {
+                bits[glob_offs + v].resize(
+                    sharded_borders[num_shards - 1][v] + sharded_hists[num_shards - 1][v]);
+            }
+
+            // the first word of an interval that does not start at a word
+            // boundary may be shared with the previous thread
+            for (size_t v = 0; v < num_level_nodes; v++) {
+                const size_t offs = border[v];
+                head[v] = 0;
+                head_word[v] = (offs & 63ULL) ? (offs >> 6) : UINT64_MAX;
+            }
+
+            auto write_word = [&](const size_t v, const size_t w, const uint64_t x) {
+                if (w == head_word[v]) {
+                    head[v] |= x;
+                } else {
+                    bits[glob_offs + v].data()[w] |= x;
+                }
+            };
+
+            // extract the node bits from every block
+            bit_extract::dispatch([&](auto ops) {
+                for (size_t b = block_begin; b < block_end; b++) {
+                    const uint64_t* const block = planes.data() + b * h;
+                    const uint64_t valid = valid_mask(b);
+
+                    for (size_t v = 0; v < num_level_nodes; v++) {
+                        const uint64_t m = node_mask(block, level, v, valid);
+                        const size_t num = __builtin_popcountll(m);
+                        if (num == 0) continue;
+
+                        // the node's bits, aligned to the most significant bit
+                        const uint64_t x = decltype(ops)::compress_bits(block[level], m) << (64 - num);
+
+                        const size_t pos = border[v];
+                        border[v] += num;
+
+                        const size_t s = pos & 63ULL;
+                        write_word(v, pos >> 6, x >> s);
+                        if (s + num > 64) {
+                            write_word(v, (pos >> 6) + 1, x << (64 - s));
+                        }
+                    }
+                }
+            });
+
+#pragma omp barrier
+
+            // merge the shared head words, one node per thread
+#pragma omp for
+            for (size_t v = 0; v < num_level_nodes; v++) {
+                uint64_t* const words = bits[glob_offs + v].data();
+                for (size_t s = 1; s < num_shards; s++) {
+                    // borders have been advanced to the end of each interval
+                    const uint64_t head_bits = sharded_heads[s][v];
+                    if (head_bits) {
+                        words[sharded_borders[s - 1][v] >> 6] |= head_bits;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// root_sym(i) yields the i-th text symbol during the root level pass,
+// which is the only pass that does not read the text directly
+// text[i] must hold the symbol afterwards, the root level bits are
+// extracted from the text
+template <typename sym_t, typename idx_t, typename root_t>
+static void start(wt_bits_t& bits, const sym_t* text, const size_t n, const size_t h, root_t root_sym) {
+    if (h == 0) {
+        // a text of a single symbol has a tree without levels,
+        // only the text is computed
+#pragma omp parallel for
+        for (size_t i = 0; i < n; i++) {
+            root_sym(i);
+        }
+        return;
+    }
+
+    // parallelizing over levels would leave threads idle for small alphabets,
+    // unless the scratch of the domain decomposition outgrows the text
+    const size_t max_threads = omp_get_max_threads();
+    const bool scratch_fits =
+        DD_SCRATCH_ARRAYS * max_threads <= ((n / DD_MAX_SCRATCH_RATIO) >> h);
+    if (h - 1 < max_threads && scratch_fits) {
+        start_domain_decomposed<sym_t, idx_t>(bits, text, n, h, root_sym);
+    } else {
+        start_levelwise<sym_t, idx_t>(bits, text, n, h, root_sym);
+    }
+}
+
+public:
+
+// prefix counting for wavelet subtree
+// combination of wt_pc and ppc
+template <typename sym_t, typename idx_t, typename A>
+static void start(wt_bits_t& bits, const std::vector<sym_t, A>& text, const size_t h) {
+    start<sym_t, idx_t>(bits, text.data(), text.size(), h, [&](uint64_t const i) { return text[i]; });
 }
 
 // prefix counting
@@ -123,6 +736,44 @@ start(const WaveletTreeBase& wt, wt_bits_t& bits, const std::vector<sym_t, A>& t
     start<sym_t, idx_t>(bits, text, wt.height());
 }
 
+// prefix counting fused with the computation of the text
+// text[i] = map(i) is stored while writing the root level and counting
+// the leaf histogram, so the text is not swept separately
+template <typename sym_t, typename idx_t, typename A, typename map_t>
+static void
+start(const WaveletTreeBase& wt, wt_bits_t& bits, std::vector<sym_t, A>& text, map_t map) {
+    sym_t* const out = text.data();
+    start<sym_t, idx_t>(bits, text.data(), text.size(), wt.height(), [&](uint64_t const i) {
+        const sym_t c = map(i);
+        out[i] = c;
+        return c;
+    });
+}
+
+// prefix counting directly on a text buffer, e.g., an input that is
+// already in the effective alphabet
+template <typename sym_t, typename idx_t>
+static void
+start(const WaveletTreeBase& wt, wt_bits_t& bits, const sym_t* text, const size_t n) {
+    start<sym_t, idx_t>(bits, text, n, wt.height(), [&](uint64_t const i) { return text[i]; });
+}
+
+// prefix counting on a bit-sliced text of at most PACKED_MAX_HEIGHT bits
+// per symbol, which is packed from map(i) while writing the root level
+// the text occupies h bits per symbol and is released afterwards
+template <typename idx_t, typename map_t>
+static void
+start_packed(const WaveletTreeBase& wt, wt_bits_t& bits, const size_t n, map_t map) {
+    // a tree without levels does not need the text
+    if (wt.height() == 0) return;
+
+    // the planes of a block and the levels' nodes are iterated with
+    // compile-time bounds
+    util::with_height<PACKED_MAX_HEIGHT>(wt.height(), [&](auto height) {
+        start_bit_sliced<decltype(height)::value, idx_t>(bits, n, wt.height(), map);
+    });
+}
+
 static std::string name() {
   return "ppc";
 }
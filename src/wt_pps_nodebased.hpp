@@ -11,12 +11,15 @@
 #include <src/omp_write_bits.hpp>
 
 // pps from the distwt repositiory, include/construction/pps.hpp
-template <typename AlphabetType, typename ContextType>
+// root_sym(i) yields the i-th text symbol while the first level is written,
+// after which text[i] must hold it
+template <typename AlphabetType, typename ContextType, typename RootType>
 void pps(AlphabetType const* text,
          const uint64_t size,
          const uint64_t levels,
          ContextType& ctx,
-         wt_bits_t& bv) {
+         wt_bits_t& bv,
+         RootType root_sym) {
   auto sorted_text_ = std::vector<AlphabetType>(size);
   auto sorted_text = span<AlphabetType>(sorted_text_);
 
@@ -35,11 +38,13 @@ void pps(AlphabetType const* text,
       auto&& rank_hist = ctx.hist_at_shard(omp_rank);
 
       // While initializing the histogram, we also compute the first level
-      omp_write_bits_vec(0, size, bv[0], [&](uint64_t const i) {
-        rank_hist[text[i]]++;
-        uint64_t bit = ((text[i] >> (levels - 1)) & 1ULL);
-        return bit;
-      });
+      // (root_sym stores the symbols in the text if it computes them)
+      omp_extract_bits_vec(0, size, bv[0], text, levels - 1,
+        [&](uint64_t const i, uint64_t const num) {
+          for (uint64_t j = i; j < i + num; ++j) {
+            rank_hist[root_sym(j)]++;
+          }
+        });
     }
 
     #pragma omp single
@@ -157,9 +162,7 @@ void pps(AlphabetType const* text,
       #pragma omp barrier
 
       //we need to write to all bit vectors of the current level
-      omp_write_bits_level(level, bv, [&](uint64_t pos) {
-        return (sorted_text[pos] & 1ULL) != 0;
-      });
+      omp_extract_bits_level(level, bv, sorted_text.data(), 0);
     }
   }
 }
@@ -182,8 +185,23 @@ public:
 class wt_pps_nodebased {
 public:
 
-template <typename sym_t, typename idx_t, typename A>
-static void start(wt_bits_t& bits, const std::vector<sym_t, A>& text, const size_t h) {
+// the text can not be bit-sliced
+static constexpr size_t PACKED_MAX_HEIGHT = 0;
+
+private:
+
+template <typename sym_t, typename idx_t, typename root_t>
+static void start(wt_bits_t& bits, const sym_t* text, const size_t n, const size_t h, root_t root_sym) {
+    if (h == 0) {
+        // a text of a single symbol has a tree without levels,
+        // only the text is computed
+#pragma omp parallel for
+        for (size_t i = 0; i < n; i++) {
+            root_sym(i);
+        }
+        return;
+    }
+
     using ctx_t = ctx_generic<true,
                             ctx_options::borders::sharded_single_level,
                             ctx_options::hist::sharded_single_level,
@@ -192,8 +210,15 @@ static void start(wt_bits_t& bits, const std::vector<sym_t, A>& text, const size
                             empty_vectors>;
     
     const uint64_t shards = omp_get_max_threads();
-    ctx_t ctx(text.size(), h, h, shards);
-    pps(text.data(), text.size(), h, ctx, bits);
+    ctx_t ctx(n, h, h, shards);
+    pps(text, n, h, ctx, bits, root_sym);
+}
+
+public:
+
+template <typename sym_t, typename idx_t, typename A>
+static void start(wt_bits_t& bits, const std::vector<sym_t, A>& text, const size_t h) {
+    start<sym_t, idx_t>(bits, text.data(), text.size(), h, [&](uint64_t const i) { return text[i]; });
 }
 
 // prefix sorting
@@ -203,6 +228,27 @@ start(const WaveletTreeBase& wt, wt_bits_t& bits, const std::vector<sym_t, A>& t
     start<sym_t, idx_t>(bits, text, wt.height());
 }
 
+// prefix sorting fused with the computation of the text
+// text[i] = map(i) is stored while writing the first level
+template <typename sym_t, typename idx_t, typename A, typename map_t>
+static void
+start(const WaveletTreeBase& wt, wt_bits_t& bits, std::vector<sym_t, A>& text, map_t map) {
+    sym_t* const out = text.data();
+    start<sym_t, idx_t>(bits, text.data(), text.size(), wt.height(), [&](uint64_t const i) {
+        const sym_t c = map(i);
+        out[i] = c;
+        return c;
+    });
+}
+
+// prefix sorting directly on a text buffer, e.g., an input that is
+// already in the effective alphabet
+template <typename sym_t, typename idx_t>
+static void
+start(const WaveletTreeBase& wt, wt_bits_t& bits, const sym_t* text, const size_t n) {
+    start<sym_t, idx_t>(bits, text, n, wt.height(), [&](uint64_t const i) { return text[i]; });
+}
+
 static std::string name() {
   return "pps";
 }
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <pwm/util/debug.hpp>
+
+#include <algorithm>
+#include <omp.h>
+#include <vector>
+
+#include <distwt/mpi/node_directory.hpp>
+#include <src/omp_write_bits.hpp>
+
+// construction of the non-empty nodes by prefix sorting
+// every level's bits are extracted from the text sorted by the symbols'
+// bits above the level, in which every node is a contiguous run, and the
+// text is then split stably by the level's bit within the runs, so the
+// memory depends on the text length and the amount of non-empty nodes only
+class wt_sparse_nodebased {
+public:
+
+// builds the h levels of the nodes of text, which is used as a buffer
+template <typename sym_t, typename allocator_t>
+static void start(
+    NodeDirectory& nodes,
+    std::vector<sym_t, allocator_t>& text,
+    const size_t h) {
+
+    start(nodes, text, h, [](size_t){ return true; });
+}
+
+// like above, but only the children for which inner(node_id) holds get
+// nodes, the symbols of the others are dropped from the text, e.g., the
+// symbols of a Huffman-shaped tree, padded to the height h, at their leaves
+template <typename sym_t, typename allocator_t, typename inner_t>
+static void start(
+    NodeDirectory& nodes,
+    std::vector<sym_t, allocator_t>& text,
+    const size_t h,
+    inner_t inner) {
+
+    using Node = NodeDirectory::Node;
+
+    size_t n = text.size();
+    nodes = NodeDirectory(h);
+    if(n == 0) return;
+
+    std::vector<sym_t, allocator_t> sorted(h > 1 ? n : 0);
+    std::vector<Node> runs = { Node { 1, 0, n } };
+    std::vector<size_t> run_zeros;
+
+    // the offsets of a run's zeros and ones in the next level's text,
+    // SIZE_MAX if they are dropped
+    std::vector<size_t> run_dst;
+
+    for(size_t level = 0; level < h; level++) {
+        const size_t bit = h - 1 - level;
+        const bool split = (level + 1 < h);
+
+        auto& level_bv = nodes.bits(level);
+        level_bv.resize(n);
+        run_zeros.resize(split ? runs.size() : 0);
+        run_dst.resize(split ? 2 * runs.size() : 0);
+
+        // the runs of the next level are the non-empty inner children in order
+        std::vector<Node> next;
+        if(split) {
+            next.reserve(std::min(2 * runs.size(), n));
+        }
+
+        const uint64_t* const words = level_bv.data();
+#pragma omp parallel
+        {
+            omp_extract_bits_vec(0, n, level_bv, text.data(), bit);
+
+            if(split) {
+                // the extraction's boundary words are written after its loop
+#pragma omp barrier
+
+#pragma omp for schedule(nonmonotonic : dynamic, 64)
+                for(size_t r = 0; r < runs.size(); r++) {
+                    run_zeros[r] = runs[r].size -
+                        count_ones(words, runs[r].offs, runs[r].size);
+                }
+
+#pragma omp single
+                {
+                    size_t offs = 0;
+                    for(size_t r = 0; r < runs.size(); r++) {
+                        const auto& run = runs[r];
+                        const size_t sizes[2] = { run_zeros[r], run.size - run_zeros[r] };
+
+                        for(size_t c = 0; c < 2; c++) {
+                            const size_t node_id = 2 * run.node_id + c;
+                            if(sizes[c] > 0 && inner(node_id)) {
+                                next.push_back(Node { node_id, offs, sizes[c] });
+                                run_dst[2 * r + c] = offs;
+                                offs += sizes[c];
+                            } else {
+                                run_dst[2 * r + c] = SIZE_MAX;
+                            }
+                        }
+                    }
+                }
+
+                // every thread splits the parts of the runs in its share of
+                // the text, runs that span several shares are split by
+                // several threads at the offsets given by the bits before
+                const size_t omp_rank = omp_get_thread_num();
+                const size_t omp_size = omp_get_num_threads();
+                const size_t a = (n * omp_rank) / omp_size;
+                const size_t b = (n * (omp_rank + 1)) / omp_size;
+
+                size_t r = std::upper_bound(runs.begin(), runs.end(), a,
+                    [](const size_t i, const Node& run){ return i < run.offs; })
+                    - runs.begin() - 1;
+
+                for(; a < b && r < runs.size() && runs[r].offs < b; r++) {
+                    const auto& run = runs[r];
+                    const size_t p = std::max(a, run.offs);
+                    const size_t q = std::min(b, run.offs + run.size);
+
+                    const size_t zero_dst = run_dst[2 * r];
+                    const size_t one_dst = run_dst[2 * r + 1];
+                    if(zero_dst == SIZE_MAX && one_dst == SIZE_MAX) continue;
+
+                    const size_t ones = count_ones(words, run.offs, p - run.offs);
+                    if(zero_dst != SIZE_MAX && one_dst != SIZE_MAX) {
+                        size_t z = zero_dst + (p - run.offs - ones);
+                        size_t o = one_dst + ones;
+
+                        for(size_t i = p; i < q; i++) {
+                            const sym_t sym = text[i];
+                            // select the destination by a mask, a branch
+                            // would be mispredicted on random bits
+                            const size_t one = (sym >> bit) & 1;
+                            sorted[z + ((o - z) & (size_t(0) - one))] = sym;
+                            o += one;
+                            z += one ^ 1;
+                        }
+                    } else {
+                        // only one child is kept
+                        const bool keep_one = (one_dst != SIZE_MAX);
+                        size_t d = keep_one ? one_dst + ones : zero_dst + (p - run.offs - ones);
+
+                        for(size_t i = p; i < q; i++) {
+                            const sym_t sym = text[i];
+                            if(bool((sym >> bit) & 1) == keep_one) sorted[d++] = sym;
+                        }
+                    }
+                }
+            }
+        }
+
+        if(split) {
+            n = next.empty() ? 0 : next.back().offs + next.back().size;
+            text.swap(sorted);
+        }
+
+        nodes.nodes(level) = std::move(runs);
+        runs = std::move(next);
+    }
+}
+
+};